@@ -19,6 +19,16 @@ struct args {
     char *fname;
     // Amount of threads to use. Not all programs implement this.
     int n_threads;
+    // Samples per pixel, or 0 for the program's default. Not all programs implement this.
+    int samples;
+    // Whether to denoise the image before writing it. Not all programs implement this.
+    bool denoise;
+    // Lines per strip when writing the image as it is rendered, or 0 to render
+    // the whole image first. Not all programs implement this.
+    int strip_lines;
+    // Whether to run an interactive preview instead of a full render. Not all
+    // programs implement this.
+    bool preview;
 };
 
 // Parses args into a format that can more easily be used.
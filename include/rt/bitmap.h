@@ -37,8 +37,8 @@ class bitmap {
     bitmap(int image_width, int image_height) {
         this->image_width = image_width;
         this->image_height = image_height;
-        // 3 bytes for a 24bpp pixel
-        this->raw_size = image_width * image_height * 3;
+        // 3 bytes for a 24bpp pixel. This is 64-bit, as gigapixel images overflow an int.
+        this->raw_size = size_t(image_width) * image_height * 3;
         // I use a unique_ptr<> because I need sane move semantics.
         pixel_data = std::make_unique<uint8_t[]>(this->raw_size);
     }
@@ -51,6 +51,10 @@ class bitmap {
         return image_height;
     }
 
+    size_t get_raw_size() {
+        return raw_size;
+    }
+
     // Row and column index starting from 0.
     void write_pixel_rgb(int row, int column, uint8_t r, uint8_t g, uint8_t b);
 
@@ -92,7 +96,7 @@ class bitmap {
     // Internal and immutable data here.
     int image_width;
     int image_height;
-    int raw_size;
+    size_t raw_size;
 
     /* Internal methods here. Internal methods are called by this->method(),
      * or simply by method() (no reference to object).
@@ -6,11 +6,17 @@
 #include "color.h"
 // To allow returning a bitmap
 #include "bitmap.h"
+// For renders which are post-processed before conversion to a bitmap
+#include "framebuffer.h"
+// For renders which are encoded a strip at a time
+#include "strip-writer.h"
 
 // For std::mutex, std::recursive_mutex
 #include <mutex>
-// For std::atomic_int
+// For std::atomic_int, std::atomic_bool
 #include <atomic>
+// For std::function
+#include <functional>
 
 namespace rt {
 
@@ -39,6 +45,10 @@ class camera {
     double defocus_angle = 0; // Variation angle of rays through each pixel
     double focus_dist = 10; // Distance from camera's lookfrom to plane of perfect focus
 
+    // Render with kernels compiled for these settings and the materials in the
+    // scene. Turn it off to compare with the generic (slower) path.
+    bool specialize = true;
+
     std::recursive_mutex render_mutex; // Blocks doing multiple incompatible renders at once.
 
     // Single-threaded renderer
@@ -46,6 +56,26 @@ class camera {
     // Multithreaded renderer. n_threads must be >= 0 (0 meaning "use all threads available").
     // If n_threads is 1, it will fall back to the single-threaded renderer.
     bitmap render(const hittable &world, int n_threads);
+    // Multithreaded renderer which keeps the image in linear floating-point form
+    // (for post-processing like denoising). If with_aux is true, it also stores
+    // the first-hit albedo and normal of each pixel.
+    framebuffer render_linear(const hittable &world, int n_threads, bool with_aux);
+    // Multithreaded renderer which renders strip_height lines at a time and
+    // passes each strip to out, so memory use depends on the strip size instead
+    // of the image size. Threads split each strip by lines, so strip_height is
+    // raised to the thread count if it is smaller. Returns false if out fails to write.
+    bool render_strips(const hittable &world, int n_threads, int strip_height, strip_writer &out);
+    // Progressive renderer: renders samples more samples per pixel and averages
+    // them into fb, which already holds samples_done samples per pixel (if the
+    // size doesn't match, it is replaced by a new framebuffer first). This
+    // ignores samples_per_pixel and prints no progress, as it is meant to be
+    // run over and over. Returns false (leaving fb partly updated) if cancel
+    // becomes true before it finishes.
+    bool render_pass(const hittable &world, int n_threads, framebuffer &fb, int samples_done,
+                     int samples, const std::atomic_bool &cancel);
+
+    // Copies the public camera parameters (but not the mutex) from other.
+    void copy_settings(const camera &other);
   private:
     // Place private camera variables here.
     int image_height; // Rendered image height
@@ -61,11 +91,48 @@ class camera {
     // Multithreading extensions
     std::atomic_int lines_remaining = -1; // Stores remaining lines for multithreaded mode.
 
-    // line_begin and line_end use inedxing conventions.
-    void render_mt_impl(const hittable &world, bitmap &raw_bmp, int line_begin, int line_end);
+    // line_begin and line_end use inedxing conventions. bmp_first_line is the
+    // image line that the first line of raw_bmp holds (for strips).
+    void render_mt_impl(const hittable &world, bitmap &raw_bmp, int line_begin, int line_end,
+                        int bmp_first_line);
+    void render_linear_mt_impl(const hittable &world, framebuffer &fb, int line_begin, int line_end);
+    bool render_pass_mt_impl(const hittable &world, framebuffer &fb, int line_begin, int line_end,
+                             int samples_done, int samples, const std::atomic_bool &cancel);
+
+    // Takes render_mutex, warning if another render is already running.
+    std::unique_lock<std::recursive_mutex> lock_render();
+    // Resolves n_threads of 0 to the number of CPUs, and limits it to image_height.
+    int pick_thread_count(int n_threads);
+    // Splits lines [line_begin, line_end) between threads running render_block(line_begin, line_end).
+    void run_line_blocks(int n_threads, int line_begin, int line_end,
+                         const std::function<void(int, int)> &render_block);
+
+    // Also picks the render kernel for world.
+    void initialize(const hittable &world);
+    // If albedo and normal are non-null, the first hit's albedo and normal are added to them.
+    color ray_color(const ray &r, int depth, const hittable &world,
+                    color *albedo = nullptr, vec3 *normal = nullptr);
+
+    /* Render kernels, which return the sum of samples samples for pixel (i, j).
+     * The specialized ones are compiled for each combination of settings, and
+     * one is picked at the start of a render, so the hot loop doesn't check
+     * any settings per sample.
+     */
+    // direct is for max_depth 1, where only camera rays count (so nothing scatters).
+    enum class depth_class { direct, bounded };
+    // Which materials the scene has: only lambertian, only built-in ones
+    // (picked by kind() and called without virtual calls), or anything
+    // (always called through the virtual scatter()).
+    enum class material_set { lambertian, builtin, any };
+    using kernel_fn = color (camera::*)(const hittable &world, int i, int j, int samples);
+    kernel_fn kernel = &camera::sample_pixel_generic;
 
-    void initialize();
-    color ray_color(const ray &r, int depth, const hittable &world);
+    kernel_fn pick_kernel(const hittable &world) const;
+    color sample_pixel_generic(const hittable &world, int i, int j, int samples);
+    template <bool defocus, depth_class depth, material_set materials, typename sky_model>
+    color sample_pixel(const hittable &world, int i, int j, int samples);
+    template <material_set materials>
+    static bool scatter(const ray &r_in, const hit_record &rec, color &attenuation, ray &scattered);
 
     ray get_ray(int i, int j);
     vec3 sample_square() const;
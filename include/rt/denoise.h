@@ -0,0 +1,29 @@
+#pragma once
+
+#include "framebuffer.h"
+
+namespace rt {
+
+// Tuning knobs for denoise(). Larger sigmas blur more across edges.
+struct denoise_options {
+    // Number of filter passes. Each pass doubles the filter radius, so 5
+    // passes cover a 61×61 px neighborhood.
+    int iterations = 5;
+    // How much the (albedo-divided) color may differ, as a multiple of the
+    // noise level estimated from the image. Halved every pass.
+    float color_sigma = 16.0f;
+    // How much the normals may differ (only used with aux buffers).
+    float normal_sigma = 0.3f;
+    // How much the albedo may differ (only used with aux buffers).
+    float albedo_sigma = 0.3f;
+};
+
+/* Denoises the color buffer of fb in place, using an edge-avoiding à-trous
+ * wavelet filter (Dammertz et al., 2010). It works best if fb has aux
+ * buffers, as edges in the normals and albedo are then preserved, and the
+ * albedo is divided out so textures don't get blurred.
+ * n_threads must be >= 0 (0 meaning "use all threads available").
+ */
+void denoise(framebuffer &fb, int n_threads, const denoise_options &opts = denoise_options());
+
+}
@@ -0,0 +1,76 @@
+#pragma once
+
+#include "color.h"
+#include "bitmap.h"
+#include "rgb8-convert.h"
+// For std::unique_ptr<>
+#include <memory>
+
+namespace rt {
+
+/* Floating-point image in linear space (before gamma correction), which can
+ * be post-processed (like denoising) before being converted to a bitmap.
+ * It optionally holds auxiliary buffers with the average first-hit albedo and
+ * normal of each pixel, which help guide the denoiser.
+ *
+ * Every buffer goes from left-to-right, top-to-bottom, with 3 floats per
+ * pixel (RGB or XYZ). albedo_data and normal_data are null without aux buffers.
+ *
+ * Thread-Safety: Same as bitmap, writing to non-overlapping portions from
+ * different threads is safe.
+ */
+class framebuffer {
+  public:
+    std::unique_ptr<float[]> color_data;
+    std::unique_ptr<float[]> albedo_data;
+    std::unique_ptr<float[]> normal_data;
+
+    framebuffer(int image_width, int image_height, bool with_aux);
+
+    int get_image_width() const {
+        return image_width;
+    }
+
+    int get_image_height() const {
+        return image_height;
+    }
+
+    bool has_aux() const {
+        return albedo_data != nullptr;
+    }
+
+    // Index of the first float of a pixel, in any of the buffers.
+    size_t pixel_index(int row, int column) const {
+        return 3 * (size_t(row) * image_width + column);
+    }
+
+    void write_pixel(int row, int column, const color &px_color) {
+        store(color_data.get(), row, column, px_color);
+    }
+
+    // Only valid if has_aux() is true.
+    void write_aux(int row, int column, const color &albedo, const vec3 &normal) {
+        store(albedo_data.get(), row, column, albedo);
+        store(normal_data.get(), row, column, normal);
+    }
+
+    // Gamma-corrects the color buffer into a new bitmap.
+    bitmap to_bitmap(const rgb8_options &opts = rgb8_options()) const;
+
+    // Like to_bitmap(), but reuses an existing bitmap (which must be the same
+    // size), for when the image is converted over and over (like previews).
+    void convert_to(bitmap &out, const rgb8_options &opts = rgb8_options()) const;
+
+  private:
+    int image_width;
+    int image_height;
+
+    void store(float *buf, int row, int column, const vec3 &v) {
+        size_t index = pixel_index(row, column);
+        buf[index] = v.x();
+        buf[index + 1] = v.y();
+        buf[index + 2] = v.z();
+    }
+};
+
+}
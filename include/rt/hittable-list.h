@@ -17,6 +17,8 @@ class hittable_list: public hittable {
     void add(std::shared_ptr<hittable> object);
 
     bool hit(const ray &r, interval ray_t, hit_record &rec) const override;
+
+    unsigned material_kinds() const override;
 };
 
 }
@@ -38,6 +38,12 @@ class hittable {
                      interval ray_t,
                      // rec is written to and saves calculation data.
                      hit_record &rec) const = 0;
+
+    // Which material kinds this can hit (as material_kind_bit()s), so the
+    // camera can pick a render kernel for them. The default means "anything".
+    virtual unsigned material_kinds() const {
+        return ~0u;
+    }
 };
 
 }
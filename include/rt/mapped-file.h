@@ -0,0 +1,65 @@
+#pragma once
+// For uint8_t, uint64_t
+#include <cstdint>
+
+namespace rt {
+
+/* A file mapped into memory (through mmap() or MapViewOfFile()), so its
+ * contents can be used in place without reading them into a buffer first.
+ * Check is_open() after construction, failures are logged to std::clog.
+ *
+ * This can't be copied (it would unmap twice), but pointers into data() stay
+ * valid until the mapped_file is destroyed.
+ */
+class mapped_file {
+  public:
+    // Maps an existing file read-only.
+    mapped_file(const char *fname);
+
+    // Creates (or truncates) a file of the given size, and maps it read-write.
+    // The space is reserved on disk first where the filesystem supports it, so
+    // a full disk fails here instead of crashing on a write later.
+    // Changes are written back to the file (at the latest when it is unmapped),
+    // but only flush() reports errors doing so.
+    mapped_file(const char *fname, uint64_t size);
+
+    ~mapped_file();
+
+    mapped_file(const mapped_file &) = delete;
+    mapped_file & operator =(const mapped_file &) = delete;
+
+    bool is_open() const {
+        return map_ptr != nullptr;
+    }
+
+    const uint8_t * data() const {
+        return map_ptr;
+    }
+
+    // Returns nullptr if the file was mapped read-only.
+    uint8_t * writable_data() {
+        return writable? map_ptr : nullptr;
+    }
+
+    uint64_t size() const {
+        return map_size;
+    }
+
+    // Writes changes back to the file and waits for them. Returns false on
+    // failure (which is logged), and true if the file was mapped read-only.
+    bool flush();
+
+  private:
+    uint8_t *map_ptr = nullptr;
+    uint64_t map_size = 0;
+    bool writable = false;
+#ifdef _WIN32
+    // These are HANDLEs, but I don't want <windows.h> in a public header.
+    void *file_handle = nullptr;
+    void *mapping_handle = nullptr;
+#else
+    int fd = -1;
+#endif
+};
+
+}
@@ -7,22 +7,47 @@
 
 namespace rt {
 
+// The built-in materials, so renderers can call them without virtual calls.
+enum class material_kind { other, lambertian, metal, dielectric };
+
+// A set of material kinds, for hittable::material_kinds().
+inline unsigned material_kind_bit(material_kind kind) {
+    return 1u << static_cast<int>(kind);
+}
+
 // Abstract class for materials
 class material {
   public:
+    material() = default;
     virtual ~material() = default;
 
+    // Not virtual, as the point is to avoid a virtual call.
+    material_kind kind() const {
+        return mat_kind;
+    }
+
     virtual bool scatter([[maybe_unused]] const ray &r_in,
                          [[maybe_unused]] const hit_record &rec,
                          [[maybe_unused]] color &attenuation,
                          [[maybe_unused]] ray &scattered) const {
         return false;
     }
+
+  private:
+    // Only the built-in materials can say they are one, as the renderer casts
+    // to them by kind. Everything else is material_kind::other.
+    friend class lambertian;
+    friend class metal;
+    friend class dielectric;
+    material(material_kind kind): mat_kind(kind) {}
+
+    material_kind mat_kind = material_kind::other;
 };
 
-class lambertian: public material {
+// These are final, so calls through the concrete type aren't virtual.
+class lambertian final: public material {
   public:
-    lambertian(const color &albedo): albedo(albedo) {}
+    lambertian(const color &albedo): material(material_kind::lambertian), albedo(albedo) {}
 
     bool scatter(const ray &r_in, const hit_record &rec,
                  color &attenuation, ray &scattered) const override;
@@ -31,9 +56,10 @@ class lambertian: public material {
     color albedo;
 };
 
-class metal: public material {
+class metal final: public material {
   public:
-    metal(const color &albedo, double fuzz): albedo(albedo), fuzz(fuzz < 1? fuzz:1) {}
+    metal(const color &albedo, double fuzz):
+        material(material_kind::metal), albedo(albedo), fuzz(fuzz < 1? fuzz:1) {}
 
     bool scatter(const ray &r_in, const hit_record &rec,
                  color &attenuation, ray &scattered) const override;
@@ -43,9 +69,10 @@ class metal: public material {
     double fuzz;
 };
 
-class dielectric: public material {
+class dielectric final: public material {
   public:
-    dielectric(double refraction_index): refraction_index(refraction_index) {}
+    dielectric(double refraction_index):
+        material(material_kind::dielectric), refraction_index(refraction_index) {}
 
     bool scatter(const ray &r_in, const hit_record &rec, color &attenuation, ray &scattered) const override;
 
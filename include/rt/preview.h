@@ -0,0 +1,87 @@
+#pragma once
+
+#include "camera.h"
+#include "hittable.h"
+#include "bitmap.h"
+#include "framebuffer.h"
+
+// For std::condition_variable
+#include <condition_variable>
+// For std::function
+#include <functional>
+#include <mutex>
+#include <thread>
+
+namespace rt {
+
+struct preview_frame {
+    // Always the full image size (coarse frames are scaled up), so it can be
+    // written over the same file every time.
+    bitmap &image;
+    // How many times smaller than the full image this was rendered (8, 4, 2 or 1).
+    int scale;
+    // Samples per pixel so far.
+    int samples_per_pixel;
+    // Time since the camera settings last changed.
+    double seconds;
+    // Whether this is the last frame for these settings (it reached the
+    // camera's samples_per_pixel).
+    bool done;
+};
+
+/* Renders a quick preview in the background to help with setting up the
+ * camera. It starts with a frame at 1/8 resolution and 1 sample per pixel,
+ * then refines it at 1/4, 1/2 and full resolution (the 1/8 and 1/4 frames
+ * stop rays after one bounce, to show up sooner), then doubles the samples
+ * per pixel until it reaches the camera's samples_per_pixel. Every refined
+ * frame is passed to the callback (on the preview thread).
+ *
+ * Changing the camera with update() cancels the frame in progress and starts
+ * again from the coarsest one. world must outlive the previewer.
+ */
+class previewer {
+  public:
+    using frame_callback = std::function<void(const preview_frame &frame)>;
+
+    // n_threads must be >= 0 (0 meaning "use all threads available").
+    previewer(const hittable &world, int n_threads, frame_callback on_frame);
+    // Stops the preview thread (cancelling any frame in progress).
+    ~previewer();
+
+    previewer(const previewer &) = delete;
+    previewer & operator =(const previewer &) = delete;
+
+    // Copies the settings of cam and restarts refinement with them.
+    void update(const camera &cam);
+
+    // Waits until the latest settings are fully refined.
+    void wait_until_done();
+
+    // Returns a callback which writes each frame over fname. It writes to a
+    // temporary file first, then renames it, so a program watching the file
+    // never sees a partly-written image.
+    static frame_callback file_writer(const char *fname, BitmapOutput filetype);
+
+  private:
+    const hittable &world;
+    int n_threads;
+    frame_callback on_frame;
+
+    std::mutex mutex;
+    std::condition_variable changed;
+    camera pending; // Settings from the latest update(), protected by mutex.
+    bool has_pending = false;
+    bool idle = true;
+    bool quit = false;
+    std::atomic_bool cancel = false; // Set to stop the frame in progress.
+
+    // Only used by the preview thread.
+    camera view;
+    std::thread worker;
+
+    void run();
+    // Renders every refinement for the current view, stopping early if cancelled.
+    void refine();
+};
+
+}
@@ -0,0 +1,29 @@
+#pragma once
+
+// For uint8_t
+#include <cstdint>
+
+namespace rt {
+
+struct rgb8_options {
+    // Look up the gamma correction in a table instead of taking square roots.
+    // Both give exactly the same bytes as bitmap::write_pixel_vec3(), but the
+    // table is only faster without SSE2 (there's no vector gather until AVX2).
+    bool use_lut = false;
+    // Ordered (8x8 Bayer) dithering, which breaks up banding in dark gradients.
+    // It changes each byte by at most 1.
+    bool dither = false;
+};
+
+/* Converts a row of n_pixels linear colors (3 floats per pixel, RGB) into
+ * gamma-corrected R8G8B8, the same layout as bitmap::pixel_data. row is only
+ * used to pick the dither pattern.
+ *
+ * This works on whole rows at a time (with SSE2 where available), so it
+ * avoids the bounds checks and per-pixel calls of write_pixel_vec3().
+ * Negative values and NaNs become 0, values of 1 and up become 255.
+ */
+void linear_to_rgb8_row(const float *in, uint8_t *out, int n_pixels, int row,
+                        const rgb8_options &opts = rgb8_options());
+
+}
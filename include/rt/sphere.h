@@ -13,6 +13,8 @@ class sphere: public hittable {
 
     bool hit(const ray &r, interval ray_t, hit_record &rec) const override;
 
+    unsigned material_kinds() const override;
+
   private:
     point3 center;
     double radius;
@@ -0,0 +1,47 @@
+#pragma once
+
+// For BitmapOutput
+#include "bitmap.h"
+#include "mapped-file.h"
+#include <cstdint>
+#include <iostream>
+// For std::unique_ptr<>
+#include <memory>
+
+namespace rt {
+
+/* Encodes an image as it is rendered, a strip (band of rows) at a time, so
+ * the whole image never has to be in memory at once. Rows are passed in the
+ * same R8G8B8 layout as bitmap::pixel_data, and must be written in order from
+ * top to bottom.
+ *
+ * Not every format can be written this way: lossless WebP and TurboJPEG 3
+ * need the whole image at once. Check type_is_supported() first.
+ */
+class strip_writer {
+  public:
+    virtual ~strip_writer() = default;
+
+    // Writes the header. Returns false on failure.
+    virtual bool begin(int image_width, int image_height) = 0;
+
+    // Writes n_rows rows (of image_width pixels each). Returns false on failure.
+    virtual bool write_rows(const uint8_t *rows, int n_rows) = 0;
+
+    // Finishes the image after the last row. Returns false on failure.
+    virtual bool finish() = 0;
+
+    // Creates a writer which encodes to a stream. BMP files are written
+    // top-to-bottom, as a stream can't go back to fill in the bottom rows first.
+    // Returns nullptr if the type isn't supported.
+    static std::unique_ptr<strip_writer> create(std::ostream &out, BitmapOutput filetype);
+
+    // Creates a writer which writes a standard (bottom-to-top) BMP file into a
+    // memory-mapped output file, placing each strip directly where it belongs.
+    static std::unique_ptr<strip_writer> create_mapped_bmp(const char *fname);
+
+    // Returns whether a type can be written a strip at a time.
+    static bool type_is_supported(BitmapOutput filetype);
+};
+
+}
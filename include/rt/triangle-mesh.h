@@ -0,0 +1,128 @@
+#pragma once
+#include "hittable.h"
+#include "vec3.h"
+// To keep a binary mesh mapped while it is used in place
+#include "mapped-file.h"
+// For uint32_t, uint64_t
+#include <cstdint>
+// For std::ostream
+#include <iostream>
+// For std::shared_ptr, std::unique_ptr
+#include <memory>
+// For std::vector
+#include <vector>
+
+namespace rt {
+
+// These are stored as-is in the binary mesh format, so keep them plain.
+// Vertices are single-precision to halve the memory use of big meshes.
+struct mesh_vertex {
+    float x, y, z;
+};
+
+// Indices into the vertex buffer, in counterclockwise order.
+struct mesh_triangle {
+    uint32_t v[3];
+};
+
+struct mesh_bvh_node {
+    float bounds_min[3];
+    float bounds_max[3];
+    // For leaves, the first triangle in it. For inner nodes, the index of
+    // the second child (the first child always directly follows its parent).
+    uint32_t offset;
+    // Number of triangles in a leaf, 0 for inner nodes.
+    uint16_t count;
+    // Axis that an inner node was split on (0 = x, 1 = y, 2 = z)
+    uint16_t axis;
+};
+
+// The binary mesh format depends on these layouts.
+static_assert(sizeof(mesh_vertex) == 12, "mesh_vertex must be 12 bytes");
+static_assert(sizeof(mesh_triangle) == 12, "mesh_triangle must be 12 bytes");
+static_assert(sizeof(mesh_bvh_node) == 32, "mesh_bvh_node must be 32 bytes");
+
+/* Shared vertex/index buffers of a mesh, along with a BVH over its triangles.
+ * The triangles are reordered so every BVH leaf covers a contiguous range.
+ * This can be shared between multiple triangle_mesh objects (for example, to
+ * put the same mesh in the scene with different materials).
+ *
+ * The buffers are either owned by this object, or point directly into a
+ * mapped binary mesh file (see load_binary()), so read them through the
+ * accessors instead of assuming a std::vector backs them.
+ */
+class mesh_data {
+  public:
+    // Builds the BVH (which takes a while for big meshes).
+    // Throws std::invalid_argument if a triangle uses an out-of-range vertex.
+    mesh_data(std::vector<mesh_vertex> vertices, std::vector<mesh_triangle> triangles);
+
+    // Loads a Wavefront OBJ file. Only "v" and "f" lines are used (polygons
+    // are split into triangle fans). Returns nullptr on failure.
+    static std::shared_ptr<mesh_data> load_obj(const char *fname);
+
+    // Maps a binary mesh (as written by write_binary()) and uses it in place,
+    // without parsing it or building the BVH again. Returns nullptr on failure.
+    // It is checked with validate() unless trusted is true, as ray tracing
+    // doesn't check the indices in it. That reads the whole file though, so
+    // pass trusted = true for files you wrote yourself, which keeps loading
+    // down to mapping the file (pages are only read in when rays touch them).
+    static std::shared_ptr<mesh_data> load_binary(const char *fname, bool trusted = false);
+
+    // Checks that every triangle refers to vertices which exist, and that the
+    // BVH is a tree laid out like build_bvh() makes it, with leaves referring
+    // to triangles which exist, which makes it safe to trace rays against.
+    // load_binary() runs this unless told the file is trusted. It reads the
+    // whole mesh, so it pages in all of a mapped file. Returns false and logs
+    // the first problem if it finds one.
+    bool validate() const;
+
+    // Writes the mesh (including BVH) in binary form. Returns false on failure.
+    bool write_binary(std::ostream &out) const;
+
+    const mesh_vertex * vertices() const { return vertex_ptr; }
+    const mesh_triangle * triangles() const { return triangle_ptr; }
+    const mesh_bvh_node * nodes() const { return node_ptr; }
+
+    uint64_t vertex_count() const { return n_vertices; }
+    uint64_t triangle_count() const { return n_triangles; }
+    uint64_t node_count() const { return n_nodes; }
+
+  private:
+    // Used by load_binary(), which fills in the pointers itself.
+    mesh_data() {}
+
+    const mesh_vertex *vertex_ptr = nullptr;
+    const mesh_triangle *triangle_ptr = nullptr;
+    const mesh_bvh_node *node_ptr = nullptr;
+    uint64_t n_vertices = 0;
+    uint64_t n_triangles = 0;
+    uint64_t n_nodes = 0;
+
+    // Storage when the buffers are owned (empty for mapped meshes)
+    std::vector<mesh_vertex> vertex_store;
+    std::vector<mesh_triangle> triangle_store;
+    std::vector<mesh_bvh_node> node_store;
+    // Storage when the buffers are mapped from a file
+    std::unique_ptr<mapped_file> mapping;
+
+    void build_bvh();
+};
+
+// A mesh of triangles with a single material. Shading uses the flat
+// geometric normal of each triangle.
+class triangle_mesh: public hittable {
+  public:
+    triangle_mesh(std::shared_ptr<const mesh_data> data, std::shared_ptr<material> mat):
+        data(data), mat(mat) {}
+
+    bool hit(const ray &r, interval ray_t, hit_record &rec) const override;
+
+    unsigned material_kinds() const override;
+
+  private:
+    std::shared_ptr<const mesh_data> data;
+    std::shared_ptr<material> mat;
+};
+
+}
@@ -32,12 +32,24 @@ static void print_help(bool is_err, char *progname) {
 "  -h, --help            show this help message and exit\n"
 "  -T NUM, --threads NUM Set the number of threads to run with. 0 is all threads\n"
 "                        (the default setting).\n"
+"  -s NUM, --samples NUM Set the number of samples per pixel.\n"
+"  -d, --denoise         Denoise the image before writing it (allows using far\n"
+"                        fewer samples per pixel).\n"
+"  -S NUM, --strip-lines NUM\n"
+"                        Render NUM lines at a time and write each strip out\n"
+"                        directly, so the whole image is never held in memory.\n"
+"                        Each thread renders whole lines, so NUM is raised to\n"
+"                        the number of threads if it is smaller. Doesn't work\n"
+"                        with --denoise or webp.\n"
+"  -p, --preview         Write quick, progressively refined previews to FILE\n"
+"                        while reading camera settings from stdin (type \"help\"\n"
+"                        for the commands).\n"
 "  -t TYPE, --type TYPE  Set output file type. If stdout is specified, default\n"
 "                        to ppm format. (Options: bmp, ppm";
 
     std::ostream &output = is_err? std::clog : std::cout;
 
-    output << "usage: " << progname << " [-h] [-T NUM] [-t TYPE] [FILE]\n" << help_str;
+    output << "usage: " << progname << " [-h] [-T NUM] [-s NUM] [-d] [-S NUM] [-p] [-t TYPE] [FILE]\n" << help_str;
     if (png_supported)
         output << ", png";
     if (jpeg_supported)
@@ -152,7 +164,9 @@ struct rt::args rt::parse_args(int argl, char **args) {
         nproc = 1;
     // Default argument values
     struct args parsed_args = {.fname_pos = -1, .ftype = BitmapOutput::PPM,
-                               .fname = nullptr, .n_threads = nproc};
+                               .fname = nullptr, .n_threads = nproc,
+                               .samples = 0, .denoise = false,
+                               .strip_lines = 0, .preview = false};
 
     if (argl == 1)
         return parsed_args;
@@ -160,6 +174,8 @@ struct rt::args rt::parse_args(int argl, char **args) {
     // I could use a bool here to indicate "next argument is threads" but then
     // I have to manually unset it at the handler.
     int n_threads_pos = -1;
+    int samples_pos = -1;
+    int strip_lines_pos = -1;
     // To avoid resetting explicit type with implicit type
     bool type_is_set_explicitly = false;
     // Stop processing positional arguments
@@ -178,9 +194,13 @@ struct rt::args rt::parse_args(int argl, char **args) {
         StringView sv(args[index]);
         StringView type_name;
         StringView thread_num_string;
+        StringView samples_string;
+        StringView strip_lines_string;
         bool set_type = false;
         bool set_fname = false;
         bool set_thread_num = false;
+        bool set_samples = false;
+        bool set_strip_lines = false;
 
         if (no_more_options) {
             // It has been declared that there are no more positional arguments.
@@ -220,6 +240,38 @@ struct rt::args rt::parse_args(int argl, char **args) {
             set_thread_num = true;
             // Slice sv[2:]
             thread_num_string = sv.substr(2);
+        } else if (samples_pos == index) {
+            set_samples = true;
+            samples_string = sv;
+        } else if (sv == "--samples"sv || sv == "-s"sv) {
+            samples_pos = index + 1;
+            continue; // Do next iteration
+        } else if (sv.starts_with("--samples=")) {
+            set_samples = true;
+            // Slice sv[10:]
+            samples_string = sv.substr(10);
+        } else if (sv.starts_with("-s")) {
+            set_samples = true;
+            // Slice sv[2:]
+            samples_string = sv.substr(2);
+        } else if (strip_lines_pos == index) {
+            set_strip_lines = true;
+            strip_lines_string = sv;
+        } else if (sv == "--strip-lines"sv || sv == "-S"sv) {
+            strip_lines_pos = index + 1;
+            continue; // Do next iteration
+        } else if (sv.starts_with("--strip-lines=")) {
+            set_strip_lines = true;
+            // Slice sv[14:]
+            strip_lines_string = sv.substr(14);
+        } else if (sv.starts_with("-S")) {
+            set_strip_lines = true;
+            // Slice sv[2:]
+            strip_lines_string = sv.substr(2);
+        } else if (sv == "--denoise"sv || sv == "-d"sv) {
+            parsed_args.denoise = true;
+        } else if (sv == "--preview"sv || sv == "-p"sv) {
+            parsed_args.preview = true;
         } else if (sv == "--"sv) {
             no_more_options = true;
         } else if (sv == "-"sv) {
@@ -342,6 +394,48 @@ struct rt::args rt::parse_args(int argl, char **args) {
                 exit(1);
             }
         }
+
+        if (set_samples) {
+            // Set (explicit) samples per pixel
+            auto [ptr, err] = std::from_chars(samples_string.data(),
+                                              samples_string.data() + samples_string.size(),
+                                              parsed_args.samples);
+
+            if (err == std::errc::invalid_argument) {
+                std::clog << "Not a number: " << samples_string << '\n';
+                exit(1);
+            } else if (err == std::errc::result_out_of_range) {
+                std::clog << "Number is too large: " << samples_string << '\n';
+                exit(1);
+            }
+            if (parsed_args.samples < 1) {
+                print_help(true, args[0]);
+                std::clog << "Number of samples must be 1 or greater (specified: "
+                          << parsed_args.samples << ")\n";
+                exit(1);
+            }
+        }
+
+        if (set_strip_lines) {
+            // Set (explicit) lines per strip
+            auto [ptr, err] = std::from_chars(strip_lines_string.data(),
+                                              strip_lines_string.data() + strip_lines_string.size(),
+                                              parsed_args.strip_lines);
+
+            if (err == std::errc::invalid_argument) {
+                std::clog << "Not a number: " << strip_lines_string << '\n';
+                exit(1);
+            } else if (err == std::errc::result_out_of_range) {
+                std::clog << "Number is too large: " << strip_lines_string << '\n';
+                exit(1);
+            }
+            if (parsed_args.strip_lines < 1) {
+                print_help(true, args[0]);
+                std::clog << "Number of lines per strip must be 1 or greater (specified: "
+                          << parsed_args.strip_lines << ")\n";
+                exit(1);
+            }
+        }
     }
     return parsed_args;
 }
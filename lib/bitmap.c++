@@ -46,7 +46,7 @@
 #endif
 
 // Quality definitions
-#define JPEG_QUALITY 95
+#include "encoder-settings.h"
 
 // Global functions
 
@@ -112,7 +112,7 @@ void rt::bitmap::write_pixel_rgb(int row, int column, uint8_t r, uint8_t g, uint
     }
 
     // If I did this correctly
-    int pixel_index = 3 * ((row * image_width) + column);
+    size_t pixel_index = 3 * ((size_t(row) * image_width) + column);
     if (pixel_index > raw_size - 1) {
         std::clog << "Index " << pixel_index << " is out of bounds!\n";
         return;
@@ -128,7 +128,7 @@ void rt::bitmap::write_pixel_vec3(int row, int column, const color &px_color) {
         return;
     }
 
-    int pixel_index = 3 * ((row * image_width) + column);
+    size_t pixel_index = 3 * ((size_t(row) * image_width) + column);
     if (pixel_index > raw_size - 1) {
         std::clog << "Somehow reaching beyond the actual image?\n";
         return;
@@ -185,8 +185,8 @@ void rt::bitmap::write_as_ppm(std::ostream &out) {
     // PPM header
     out << "P3\n" << image_width << ' ' << image_height << "\n255\n";
     // It should roll over into a new row when the index is a multiple of this.
-    int new_row_multiple = 3 * image_width;
-    for (int index = 0; index < raw_size; index += 3) {
+    size_t new_row_multiple = 3 * size_t(image_width);
+    for (size_t index = 0; index < raw_size; index += 3) {
         // I have to convert to int or it will print as if an ASCII character.
         int r = int(pixel_data[index]);
         int g = int(pixel_data[index + 1]);
@@ -202,34 +202,17 @@ void rt::bitmap::write_as_ppm(std::ostream &out) {
 
 // Writes out bitmap to BMP, written top-to-bottom order.
 void rt::bitmap::write_as_bmp_ttb(std::ostream &out) {
-    int new_row_multiple = image_width * 3;
+    size_t new_row_multiple = 3 * size_t(image_width);
     // To be used as padding with padding_size
     char padding[3] = {0, 0, 0};
-    int padding_size = new_row_multiple % 4;
-    // It is padded to 4 bytes
-    int filled_row_size = new_row_multiple + padding_size;
-
-    int bmp_pxtable_size = filled_row_size * image_height;
-    int bmp_file_size = bmp_pxtable_size + sizeof(struct bmp_header);
-    // FIXME: This assumes little-endian.
-    struct bmp_header hdr = {.type = 0x4d42, .bmp_size = bmp_file_size,
-                             .reserved_1 = 0, .reserved_2 = 0,
-                             .pixel_offset = 0x36, // Size of header
-                             .hdr_size = 40, // Size of subheader
-                             .pixel_width = image_width,
-                             // Negative image height causes it to be read top-to-bottom
-                             .pixel_height = -image_height,
-                             .color_planes = 1, .bpp = 24,
-                             .compression_method = BI_RGB,
-                             .raw_image_size = bmp_pxtable_size,
-                             // px/m, 3780 px/m is approx. 96 px/in
-                             .horiz_dpm = 3780, .vert_dpm = 3780,
-                             .color_palette_size = 0, // All colors
-                             .num_important_colors = 0 // Unimportant
-                            };
+    // Each row is padded to a multiple of 4 bytes
+    size_t padding_size = bmp_row_size(image_width) - new_row_multiple;
+
+    // Negative image height causes it to be read top-to-bottom
+    struct bmp_header hdr = bmp_make_header(image_width, -image_height);
     // Write header as raw binary data
     out.write(reinterpret_cast<char *>(&hdr), sizeof(hdr));
-    for (int index = 0; index < raw_size; index += 3) {
+    for (size_t index = 0; index < raw_size; index += 3) {
         // Reverse order of pixel colors.
         uint8_t pxbuf[3] = {pixel_data[index + 2],
                             pixel_data[index + 1],
@@ -237,7 +220,8 @@ void rt::bitmap::write_as_bmp_ttb(std::ostream &out) {
         // The cast here is because std::ostream::write() only accepts char *,
         // and it avoid a compiler warning.
         out.write(reinterpret_cast<char *>(pxbuf), 3);
-        if (index > 0 && index % new_row_multiple == 0) {
+        // Pad after the last pixel of each row.
+        if ((index + 3) % new_row_multiple == 0) {
             out.write(padding, padding_size);
         }
     }
@@ -246,47 +230,29 @@ void rt::bitmap::write_as_bmp_ttb(std::ostream &out) {
 // Writes out bitmap to BMP, written bottom-to-top order.
 // This one is line-buffered, so it goes faster than the top-to-bottom writer.
 void rt::bitmap::write_as_bmp_btt(std::ostream &out) {
-    int new_row_multiple = image_width * 3;
-    // Determine how much padding is needed.
-    int padding_size = new_row_multiple % 4;
+    size_t new_row_multiple = 3 * size_t(image_width);
     // It is padded to 4 bytes
-    int filled_row_size = new_row_multiple + padding_size;
-
-    int bmp_pxtable_size = filled_row_size * image_height;
-    int bmp_file_size = bmp_pxtable_size + sizeof(struct bmp_header);
-    // FIXME: This assumes little-endian. I don't want to implement it yet.
-    struct bmp_header hdr = {.type = 0x4d42, .bmp_size = bmp_file_size,
-                             .reserved_1 = 0, .reserved_2 = 0,
-                             .pixel_offset = 0x36, // Size of header
-                             .hdr_size = 40, // Size of subheader
-                             .pixel_width = image_width,
-                             // Positive image height causes it to be read bottom-to-top
-                             .pixel_height = image_height,
-                             .color_planes = 1, .bpp = 24,
-                             .compression_method = BI_RGB,
-                             .raw_image_size = bmp_pxtable_size,
-                             // px/m, 3780 px/m is approx. 96 px/in
-                             .horiz_dpm = 3780, .vert_dpm = 3780,
-                             .color_palette_size = 0, // All colors
-                             .num_important_colors = 0 // Unimportant
-                            };
+    size_t filled_row_size = bmp_row_size(image_width);
+
+    // Positive image height causes it to be read bottom-to-top
+    struct bmp_header hdr = bmp_make_header(image_width, image_height);
     // Write header as raw binary data
     out.write(reinterpret_cast<char *>(&hdr), sizeof(hdr));
 
-    int top_row = new_row_multiple * (image_height - 1);
-
     // This stores the buffered row.
 #ifdef HAVE_VLA
     CC_EXT uint8_t row_buf[filled_row_size];
 #else
     uint8_t *row_buf = STACK_VLARRAY(uint8_t, filled_row_size);
 #endif
-
-    // Note: row_index >= 0 is correct, it makes it write the top line.
-    for (int row_index = top_row; row_index >= 0; row_index -= new_row_multiple) {
-        // We iterate forward through the row, but rows count backwards.
-        for (int offset = 0; offset < new_row_multiple; offset += 3) {
-            int index = row_index + offset;
+    // The padding must be zero-filled.
+    memset(row_buf, 0, filled_row_size);
+
+    // We iterate forward through the row, but rows count backwards.
+    for (int row = image_height - 1; row >= 0; row--) {
+        size_t row_index = new_row_multiple * row;
+        for (size_t offset = 0; offset < new_row_multiple; offset += 3) {
+            size_t index = row_index + offset;
             // Reverse order of pixel colors. Offset is offset within row,
             // index is accounting for row and column.
             row_buf[offset] = pixel_data[index + 2];
@@ -381,7 +347,7 @@ void rt::bitmap::write_as_png(std::ostream &out) {
         png_error(png_ptr, "Image is too tall to process in memory");
 
     for (int index = 0; index < image_height; index++) {
-        row_pointers[index] = pixel_data.get() + index * image_width * 3;
+        row_pointers[index] = pixel_data.get() + size_t(index) * image_width * 3;
     }
 
     png_write_image(png_ptr, row_pointers);
@@ -503,7 +469,7 @@ void rt::bitmap::write_as_jpeg(std::ostream &out) {
     jpeg_start_compress(&j_comp, true); // True ensures a full JPEG
 
     for (int index = 0; index < image_height; index++) {
-        row_pointers[index] = pixel_data.get() + index * image_width * 3;
+        row_pointers[index] = pixel_data.get() + size_t(index) * image_width * 3;
     }
 
     int check = jpeg_write_scanlines(&j_comp, row_pointers, image_height);
@@ -2,6 +2,8 @@
 #include <iostream>
 // For bitmap class
 #include <rt/bitmap.h>
+// For linear_to_rgb8_row()
+#include <rt/rgb8-convert.h>
 // For random_double()
 #include <rt/utils.h>
 // For material to scatter
@@ -16,44 +18,116 @@
 #include <thread>
 // For std::vector
 #include <vector>
+// For std::min()
+#include <algorithm>
+// For std::unique_ptr<>
+#include <memory>
+// For std::integral_constant
+#include <type_traits>
 
 using namespace rt;
 
+// The sky models a render kernel can use (as its sky_model). The gradient
+// from the book is the only one so far.
+struct gradient_sky {
+    // At a = 0 it is white, at a = 1.0 it is blue, blend in between.
+    static color color_of(const ray &r) {
+        vec3 unit_direction = unit_vector(r.direction());
+        auto a = 0.5 * (unit_direction.y() + 1.0);
+        // This is a linear interpolation.
+        return (1.0 - a) * color(1.0, 1.0, 1.0) + a * color(0.5, 0.7, 1.0);
+    }
+};
+
 // Internal implementation of a renderer thread.
-void rt::camera::render_mt_impl(const hittable &world, bitmap &raw_bmp, int line_begin, int line_end) {
+void rt::camera::render_mt_impl(const hittable &world, bitmap &raw_bmp, int line_begin, int line_end,
+                                int bmp_first_line) {
     // Assume it is already initialized, and that lines_remaining is correct.
 
+    // Each line is gathered as floats and converted all at once, which is a
+    // lot faster than write_pixel_vec3() for every pixel.
+    auto line = std::make_unique<float[]>(3 * size_t(image_width));
+
     for (int j = line_begin; j < line_end; j++) {
         // I assume the first status line has been printed.
+        for (int i = 0; i < image_width; i++) {
+            color pixel_color = (this->*kernel)(world, i, j, samples_per_pixel);
+
+            pixel_color *= pixel_samples_scale;
+            line[3 * i] = pixel_color.x();
+            line[3 * i + 1] = pixel_color.y();
+            line[3 * i + 2] = pixel_color.z();
+        }
+
+        linear_to_rgb8_row(line.get(), raw_bmp.pixel_data.get() + 3 * size_t(j - bmp_first_line) * image_width,
+                           image_width, j);
+
+        lines_remaining--;
+        // Apparently writes to std::clog are thread-safe.
+        rt::line_printer(lines_remaining);
+    }
+}
+
+// Internal implementation of a linear (framebuffer) renderer thread.
+void rt::camera::render_linear_mt_impl(const hittable &world, framebuffer &fb, int line_begin, int line_end) {
+    bool with_aux = fb.has_aux();
+
+    for (int j = line_begin; j < line_end; j++) {
         for (int i = 0; i < image_width; i++) {
             color pixel_color(0, 0, 0);
-            for (int sample = 0; sample < samples_per_pixel; sample++) {
-                ray r = get_ray(i, j);
-                pixel_color += ray_color(r, max_depth, world);
+            color pixel_albedo(0, 0, 0);
+            vec3 pixel_normal(0, 0, 0);
+            // Only the generic path can gather the aux buffers.
+            if (with_aux) {
+                for (int sample = 0; sample < samples_per_pixel; sample++) {
+                    ray r = get_ray(i, j);
+                    pixel_color += ray_color(r, max_depth, world, &pixel_albedo, &pixel_normal);
+                }
+            } else {
+                pixel_color = (this->*kernel)(world, i, j, samples_per_pixel);
             }
 
-            raw_bmp.write_pixel_vec3(j, i, pixel_samples_scale * pixel_color);
+            fb.write_pixel(j, i, pixel_samples_scale * pixel_color);
+            if (with_aux)
+                fb.write_aux(j, i, pixel_samples_scale * pixel_albedo,
+                             pixel_samples_scale * pixel_normal);
         }
 
         lines_remaining--;
-        // Apparently writes to std::clog are thread-safe.
         rt::line_printer(lines_remaining);
     }
 }
 
-// Multithreaded renderer function. It launches a set of renderer threads.
-bitmap rt::camera::render(const hittable &world, int n_threads) {
-    if (n_threads < 0)
-        throw std::invalid_argument("The number of threads must be 0 or greater!");
+bool rt::camera::render_pass_mt_impl(const hittable &world, framebuffer &fb, int line_begin, int line_end,
+                                     int samples_done, int samples, const std::atomic_bool &cancel) {
+    // New samples are weighted by how many there are compared to the old ones.
+    double old_weight = double(samples_done) / (samples_done + samples);
+    double new_scale = 1.0 / (samples_done + samples);
 
-    // Program crashes if either is NULL
-    assert(rt::line_printer != nullptr);
-    assert(rt::done_printer != nullptr);
+    for (int j = line_begin; j < line_end; j++) {
+        // Checked once a line, so a restart doesn't wait for the whole pass.
+        if (cancel)
+            return false;
+
+        for (int i = 0; i < image_width; i++) {
+            color pixel_color = (this->*kernel)(world, i, j, samples);
 
+            size_t index = fb.pixel_index(j, i);
+            color old_color(fb.color_data[index], fb.color_data[index + 1], fb.color_data[index + 2]);
+            fb.write_pixel(j, i, old_weight * old_color + new_scale * pixel_color);
+        }
+    }
+
+    return true;
+}
+
+std::unique_lock<std::recursive_mutex> rt::camera::lock_render() {
+    // Returns 0 if success/no-op, -1 if unavailable, positive error otherwise
     int vt_escape_status = rt::enable_vt_escapes();
 
+    // I have to make sure it isn't trying to run 2 jobs at once (data race!)
     // Note: render_mutex is a recursive mutex because it will also be locked from
-    // the single-threaded renderer if we decide to call it.
+    // the single-threaded renderer if the multithreaded one decides to call it.
     std::unique_lock<std::recursive_mutex> render_lock(render_mutex, std::try_to_lock);
 
     if (!render_lock) {
@@ -65,6 +139,10 @@ bitmap rt::camera::render(const hittable &world, int n_threads) {
         render_lock.lock();
     }
 
+    return render_lock;
+}
+
+int rt::camera::pick_thread_count(int n_threads) {
     if (n_threads == 0) {
         int nproc = std::thread::hardware_concurrency();
         if (nproc == 0)
@@ -72,16 +150,8 @@ bitmap rt::camera::render(const hittable &world, int n_threads) {
         std::clog << "Setting number of threads automatically to " << nproc << '\n';
         n_threads = nproc;
     }
-    if (n_threads == 1) {
-        std::clog << "Using single-threaded implementation.\n";
-        // This is done before camera::initialize() to avoid any change in behavior.
-        auto raw_bmp = render(world);
-        return raw_bmp;
-    }
-
-    initialize();
 
-    // Placed here because image_height is set in camera::initialize()
+    // Needs image_height, which is set in camera::initialize()
     if (n_threads > image_height) {
         // Implementation detail: I can't have more threads than image lines
         std::clog << "More threads requested than possible: reducing " << n_threads
@@ -89,20 +159,29 @@ bitmap rt::camera::render(const hittable &world, int n_threads) {
         n_threads = image_height;
     }
 
-    auto raw_bmp = bitmap(image_width, image_height);
+    return n_threads;
+}
 
-    std::clog << "Using " << n_threads << " threads.\n";
+void rt::camera::run_line_blocks(int n_threads, int line_begin, int line_end,
+                                 const std::function<void(int, int)> &render_block) {
+    int n_lines = line_end - line_begin;
+    // I can't have more threads than lines
+    if (n_threads > n_lines)
+        n_threads = n_lines;
+
+    // No point starting a thread just to wait for it.
+    if (n_threads <= 1) {
+        render_block(line_begin, line_end);
+        return;
+    }
 
-    auto block_size = image_height / n_threads;
-    auto block_remainder = image_height % n_threads; // Assigned to the last thread
+    auto block_size = n_lines / n_threads;
+    auto block_remainder = n_lines % n_threads; // Assigned to the last thread
 
     std::vector<std::thread> thread_list;
 
-    auto begin_idx = 0;
-    auto end_idx = block_size;
-
-    lines_remaining = image_height;
-    rt::print_first_lines_remaining(lines_remaining);
+    auto begin_idx = line_begin;
+    auto end_idx = line_begin + block_size;
 
     for (int tid = 0; tid < n_threads; tid++) {
         // The remainder is given to the last thread.
@@ -110,10 +189,7 @@ bitmap rt::camera::render(const hittable &world, int n_threads) {
             end_idx += block_remainder;
 
         // thread_list runs the constructor itself for vector::emplace_back().
-        thread_list.emplace_back(&camera::render_mt_impl, this,
-                                 std::cref(world),
-                                 std::ref(raw_bmp),
-                                 begin_idx, end_idx);
+        thread_list.emplace_back(std::cref(render_block), begin_idx, end_idx);
 
         begin_idx = end_idx;
         end_idx += block_size;
@@ -122,6 +198,39 @@ bitmap rt::camera::render(const hittable &world, int n_threads) {
     for (auto &t: thread_list) {
         t.join();
     }
+}
+
+// Multithreaded renderer function. It launches a set of renderer threads.
+bitmap rt::camera::render(const hittable &world, int n_threads) {
+    if (n_threads < 0)
+        throw std::invalid_argument("The number of threads must be 0 or greater!");
+
+    // Program crashes if either is NULL
+    assert(rt::line_printer != nullptr);
+    assert(rt::done_printer != nullptr);
+
+    auto render_lock = lock_render();
+
+    if (n_threads == 1) {
+        std::clog << "Using single-threaded implementation.\n";
+        // This is done before camera::initialize() to avoid any change in behavior.
+        auto raw_bmp = render(world);
+        return raw_bmp;
+    }
+
+    initialize(world);
+
+    n_threads = pick_thread_count(n_threads);
+
+    auto raw_bmp = bitmap(image_width, image_height);
+
+    std::clog << "Using " << n_threads << " threads.\n";
+    lines_remaining = image_height;
+    rt::print_first_lines_remaining(lines_remaining);
+
+    run_line_blocks(n_threads, 0, image_height, [&](int line_begin, int line_end) {
+        render_mt_impl(world, raw_bmp, line_begin, line_end, 0);
+    });
 
     // I wonder if this is breaking things somehow. Try commenting it out?
     lines_remaining = -1;
@@ -131,28 +240,148 @@ bitmap rt::camera::render(const hittable &world, int n_threads) {
     return raw_bmp;
 }
 
-bitmap rt::camera::render(const hittable &world) {
-    // Returns 0 if success/no-op, -1 if unavailable, positive error otherwise
-    int vt_escape_status = rt::enable_vt_escapes();
+framebuffer rt::camera::render_linear(const hittable &world, int n_threads, bool with_aux) {
+    if (n_threads < 0)
+        throw std::invalid_argument("The number of threads must be 0 or greater!");
 
-    // Program crashes if either is null
+    // Program crashes if either is NULL
     assert(rt::line_printer != nullptr);
     assert(rt::done_printer != nullptr);
 
-    // I have to make sure it isn't trying to run 2 jobs at once (data race!)
-    // This may be locked twice within the same thread if called from the MT renderer method.
-    std::unique_lock<std::recursive_mutex> render_lock(render_mutex, std::try_to_lock);
+    auto render_lock = lock_render();
 
-    if (!render_lock) {
-        // The "WARNING" text shows in bold red if ANSI escapes are available
-        std::clog << (vt_escape_status==0? "\033[1;31mWARNING\033[0m" : "WARNING")
-                  << ": Trying to render when already rendering! "
-                     "Thread will hang until previous job finishes.\n";
-        // Hangs until existing job is complete.
-        render_lock.lock();
+    initialize(world);
+
+    n_threads = pick_thread_count(n_threads);
+
+    auto fb = framebuffer(image_width, image_height, with_aux);
+
+    std::clog << "Using " << n_threads << " threads.\n";
+    lines_remaining = image_height;
+    rt::print_first_lines_remaining(lines_remaining);
+
+    run_line_blocks(n_threads, 0, image_height, [&](int line_begin, int line_end) {
+        render_linear_mt_impl(world, fb, line_begin, line_end);
+    });
+
+    lines_remaining = -1;
+
+    rt::done_printer();
+
+    return fb;
+}
+
+bool rt::camera::render_strips(const hittable &world, int n_threads, int strip_height,
+                               strip_writer &out) {
+    if (n_threads < 0)
+        throw std::invalid_argument("The number of threads must be 0 or greater!");
+    if (strip_height < 1)
+        throw std::invalid_argument("The strip height must be 1 or greater!");
+
+    // Program crashes if either is NULL
+    assert(rt::line_printer != nullptr);
+    assert(rt::done_printer != nullptr);
+
+    auto render_lock = lock_render();
+
+    initialize(world);
+
+    n_threads = pick_thread_count(n_threads);
+    // Each thread renders whole lines of a strip, so a thinner strip would
+    // leave threads idle (and -S 1 would be single-threaded).
+    if (strip_height < n_threads) {
+        std::clog << "Strips are split between threads by line: raising the strip height from "
+                  << strip_height << " to " << n_threads << '\n';
+        strip_height = n_threads;
+    }
+    if (strip_height > image_height)
+        strip_height = image_height;
+
+    if (!out.begin(image_width, image_height))
+        return false;
+
+    // Only this band is held in memory. It is reused for every strip.
+    auto band = bitmap(image_width, strip_height);
+
+    std::clog << "Using " << n_threads << " threads, in strips of " << strip_height << " lines.\n";
+    lines_remaining = image_height;
+    rt::print_first_lines_remaining(lines_remaining);
+
+    bool write_ok = true;
+    for (int strip_begin = 0; strip_begin < image_height && write_ok; strip_begin += strip_height) {
+        int strip_end = std::min(strip_begin + strip_height, image_height);
+
+        run_line_blocks(n_threads, strip_begin, strip_end, [&](int line_begin, int line_end) {
+            render_mt_impl(world, band, line_begin, line_end, strip_begin);
+        });
+
+        write_ok = out.write_rows(band.pixel_data.get(), strip_end - strip_begin);
+    }
+
+    lines_remaining = -1;
+
+    rt::done_printer();
+
+    if (!write_ok)
+        return false;
+    return out.finish();
+}
+
+bool rt::camera::render_pass(const hittable &world, int n_threads, framebuffer &fb, int samples_done,
+                             int samples, const std::atomic_bool &cancel) {
+    if (n_threads < 0)
+        throw std::invalid_argument("The number of threads must be 0 or greater!");
+    if (samples < 1 || samples_done < 0)
+        throw std::invalid_argument("The number of samples must be 1 or greater!");
+
+    auto render_lock = lock_render();
+
+    initialize(world);
+
+    // This is like pick_thread_count(), but quiet, as it runs over and over.
+    if (n_threads == 0)
+        n_threads = std::max(1u, std::thread::hardware_concurrency());
+
+    if (fb.get_image_width() != image_width || fb.get_image_height() != image_height) {
+        fb = framebuffer(image_width, image_height, false);
+        samples_done = 0;
     }
 
-    initialize();
+    std::atomic_bool finished = true;
+    run_line_blocks(n_threads, 0, image_height, [&](int line_begin, int line_end) {
+        if (!render_pass_mt_impl(world, fb, line_begin, line_end, samples_done, samples, cancel))
+            finished = false;
+    });
+
+    return finished;
+}
+
+void rt::camera::copy_settings(const camera &other) {
+    aspect_ratio = other.aspect_ratio;
+    image_width = other.image_width;
+    samples_per_pixel = other.samples_per_pixel;
+    max_depth = other.max_depth;
+
+    vfov = other.vfov;
+    lookfrom = other.lookfrom;
+    lookat = other.lookat;
+    vup = other.vup;
+
+    defocus_angle = other.defocus_angle;
+    focus_dist = other.focus_dist;
+
+    specialize = other.specialize;
+}
+
+bitmap rt::camera::render(const hittable &world) {
+    // Program crashes if either is null
+    assert(rt::line_printer != nullptr);
+    assert(rt::done_printer != nullptr);
+
+    // This may be locked twice within the same thread if called from the MT renderer method.
+    auto render_lock = lock_render();
+
+    initialize(world);
 
 
     // Fill in with code from main()
@@ -161,18 +390,22 @@ bitmap rt::camera::render(const hittable &world) {
     // Needed here or line counter may not print right
     rt::print_first_lines_remaining(image_height);
 
+    auto line = std::make_unique<float[]>(3 * size_t(image_width));
+
     // Go through image from left-to-right, top-to-bottom.
     for (int j = 0; j < image_height; j++) {
         rt::line_printer(image_height - j);
         for (int i = 0; i < image_width; i++) {
-            color pixel_color(0, 0, 0);
-            for (int sample = 0; sample < samples_per_pixel; sample++) {
-                ray r = get_ray(i, j);
-                pixel_color += ray_color(r, max_depth, world);
-            }
+            color pixel_color = (this->*kernel)(world, i, j, samples_per_pixel);
 
-            raw_bmp.write_pixel_vec3(j, i, pixel_samples_scale * pixel_color);
+            pixel_color *= pixel_samples_scale;
+            line[3 * i] = pixel_color.x();
+            line[3 * i + 1] = pixel_color.y();
+            line[3 * i + 2] = pixel_color.z();
         }
+
+        linear_to_rgb8_row(line.get(), raw_bmp.pixel_data.get() + 3 * size_t(j) * image_width,
+                           image_width, j);
     }
 
     rt::done_printer();
@@ -181,7 +414,7 @@ bitmap rt::camera::render(const hittable &world) {
 }
 
 // Initialize variables
-void rt::camera::initialize() {
+void rt::camera::initialize(const hittable &world) {
     image_height = int(image_width/aspect_ratio);
     image_height = (image_height < 1)? 1: image_height;
 
@@ -219,6 +452,8 @@ void rt::camera::initialize() {
     auto defocus_radius = focus_dist * std::tan(degrees_to_radians(defocus_angle / 2));
     defocus_disk_u = u * defocus_radius;
     defocus_disk_v = v * defocus_radius;
+
+    kernel = pick_kernel(world);
 }
 
 ray rt::camera::get_ray(int i, int j) {
@@ -242,8 +477,8 @@ vec3 rt::camera::sample_square() const {
     return vec3(random_double() - 0.5, random_double() - 0.5, 0);
 }
 
-// At a = 0 it is white, at a = 1.0 it is blue, blend in between.
-color rt::camera::ray_color(const ray &r, int depth, const hittable &world) {
+color rt::camera::ray_color(const ray &r, int depth, const hittable &world,
+                             color *albedo, vec3 *normal) {
     // Don't gather any more light if max depth is exceeded
     if (depth <= 0)
         return color(0, 0, 0);
@@ -254,16 +489,24 @@ color rt::camera::ray_color(const ray &r, int depth, const hittable &world) {
     if (world.hit(r, interval(0.001, infinity), rec)) {
         ray scattered;
         color attenuation;
+        bool scatters = rec.mat->scatter(r, rec, attenuation, scattered);
+        // Only the first hit is recorded (recursive calls don't pass them on).
+        if (albedo != nullptr) {
+            if (scatters)
+                *albedo += attenuation;
+            *normal += rec.normal;
+        }
         // Recurse until it stops hitting something or exceeds max depth.
-        if (rec.mat->scatter(r, rec, attenuation, scattered))
+        if (scatters)
             return attenuation * ray_color(scattered, depth - 1, world);
         return color(0, 0, 0);
     }
 
-    vec3 unit_direction = unit_vector(r.direction());
-    auto a = 0.5 * (unit_direction.y() + 1.0);
-    // This is a linear interpolation.
-    return (1.0 - a) * color(1.0, 1.0, 1.0) + a * color(0.5, 0.7, 1.0);
+    color sky = gradient_sky::color_of(r);
+    // The sky has no normal, but its color is its albedo.
+    if (albedo != nullptr)
+        *albedo += sky;
+    return sky;
 }
 
 point3 rt::camera::defocus_disk_sample() const {
@@ -271,3 +514,120 @@ point3 rt::camera::defocus_disk_sample() const {
     auto p = random_in_unit_disk();
     return center + (p[0] * defocus_disk_u) + (p[1] * defocus_disk_v);
 }
+
+// Render kernels
+
+color rt::camera::sample_pixel_generic(const hittable &world, int i, int j, int samples) {
+    color pixel_color(0, 0, 0);
+    for (int sample = 0; sample < samples; sample++) {
+        ray r = get_ray(i, j);
+        pixel_color += ray_color(r, max_depth, world);
+    }
+    return pixel_color;
+}
+
+template <rt::camera::material_set materials>
+bool rt::camera::scatter(const ray &r_in, const hit_record &rec, color &attenuation, ray &scattered) {
+    const material &mat = *rec.mat;
+    // The materials are final, so these calls aren't virtual.
+    if constexpr (materials == material_set::lambertian) {
+        return static_cast<const lambertian &>(mat).scatter(r_in, rec, attenuation, scattered);
+    } else if constexpr (materials == material_set::builtin) {
+        // pick_kernel() checked there are no other kinds, so there's no
+        // virtual call to fall back on.
+        switch (mat.kind()) {
+          case material_kind::metal:
+            return static_cast<const metal &>(mat).scatter(r_in, rec, attenuation, scattered);
+          case material_kind::dielectric:
+            return static_cast<const dielectric &>(mat).scatter(r_in, rec, attenuation, scattered);
+          // default can't happen, it's only here so every path returns.
+          case material_kind::lambertian:
+          default:
+            return static_cast<const lambertian &>(mat).scatter(r_in, rec, attenuation, scattered);
+        }
+    } else {
+        return mat.scatter(r_in, rec, attenuation, scattered);
+    }
+}
+
+template <bool defocus, rt::camera::depth_class depth, rt::camera::material_set materials,
+          typename sky_model>
+color rt::camera::sample_pixel(const hittable &world, int i, int j, int samples) {
+    color pixel_color(0, 0, 0);
+
+    for (int sample = 0; sample < samples; sample++) {
+        // Same as get_ray(), but the defocus check is done at compile time.
+        auto offset = sample_square();
+        auto pixel_sample = (pixel00_loc
+                             + ((i + offset.x()) * pixel_delta_u)
+                             + ((j + offset.y()) * pixel_delta_v));
+        point3 ray_origin;
+        if constexpr (defocus)
+            ray_origin = defocus_disk_sample();
+        else
+            ray_origin = center;
+        ray r(ray_origin, pixel_sample - ray_origin);
+
+        // Same as ray_color(), but as a loop which multiplies the attenuation
+        // as it goes, instead of recursing.
+        color attenuation_so_far(1, 1, 1);
+        for (int bounce = 0; ; bounce++) {
+            hit_record rec;
+            if (!world.hit(r, interval(0.001, infinity), rec)) {
+                pixel_color += attenuation_so_far * sky_model::color_of(r);
+                break;
+            }
+
+            // With a max_depth of 1, a bounce would go past it anyway.
+            if constexpr (depth == depth_class::direct)
+                break;
+
+            ray scattered;
+            color attenuation;
+            if (!scatter<materials>(r, rec, attenuation, scattered) || bounce + 1 >= max_depth)
+                break;
+            attenuation_so_far = attenuation_so_far * attenuation;
+            r = scattered;
+        }
+    }
+
+    return pixel_color;
+}
+
+rt::camera::kernel_fn rt::camera::pick_kernel(const hittable &world) const {
+    if (!specialize || max_depth < 1)
+        return &camera::sample_pixel_generic;
+
+    unsigned kinds = world.material_kinds();
+    unsigned builtin_kinds = material_kind_bit(material_kind::lambertian)
+                             | material_kind_bit(material_kind::metal)
+                             | material_kind_bit(material_kind::dielectric);
+    material_set materials = material_set::any;
+    if (kinds == material_kind_bit(material_kind::lambertian))
+        materials = material_set::lambertian;
+    else if ((kinds & ~builtin_kinds) == 0)
+        materials = material_set::builtin;
+
+    // This turns the settings into template arguments one at a time.
+    auto pick = [&](auto defocus, auto depth) -> kernel_fn {
+        constexpr bool defocus_v = decltype(defocus)::value;
+        constexpr depth_class depth_v = decltype(depth)::value;
+        switch (materials) {
+          case material_set::lambertian:
+            return &camera::sample_pixel<defocus_v, depth_v, material_set::lambertian, gradient_sky>;
+          case material_set::builtin:
+            return &camera::sample_pixel<defocus_v, depth_v, material_set::builtin, gradient_sky>;
+          default:
+            return &camera::sample_pixel<defocus_v, depth_v, material_set::any, gradient_sky>;
+        }
+    };
+    auto pick_depth = [&](auto defocus) -> kernel_fn {
+        if (max_depth == 1)
+            return pick(defocus, std::integral_constant<depth_class, depth_class::direct>());
+        return pick(defocus, std::integral_constant<depth_class, depth_class::bounded>());
+    };
+
+    if (defocus_angle > 0)
+        return pick_depth(std::true_type());
+    return pick_depth(std::false_type());
+}
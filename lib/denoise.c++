@@ -0,0 +1,204 @@
+#include <rt/denoise.h>
+// For std::clog
+#include <iostream>
+// For std::exp(), std::fmax()
+#include <cmath>
+// For std::thread
+#include <thread>
+// For std::vector
+#include <vector>
+// For std::invalid_argument
+#include <stdexcept>
+// For std::nth_element()
+#include <algorithm>
+
+using rt::framebuffer;
+using rt::denoise_options;
+
+// Albedo is clamped to at least this before dividing by it, to avoid
+// amplifying noise (or dividing by 0) in dark spots.
+#define MIN_ALBEDO 0.01f
+
+namespace {
+
+// Parameters for 1 pass of the filter.
+struct atrous_pass {
+    const float *in;
+    float *out;
+    const float *albedo; // May be null
+    const float *normal; // May be null
+    int width;
+    int height;
+    int step; // Distance between taps
+    float inv_color_var; // 1/sigma^2, for each of the edge-stopping functions
+    float inv_normal_var;
+    float inv_albedo_var;
+};
+
+float distance_squared(const float *a, const float *b) {
+    float dx = a[0] - b[0], dy = a[1] - b[1], dz = a[2] - b[2];
+    return dx * dx + dy * dy + dz * dz;
+}
+
+// Runs 1 pass of the filter on rows [line_begin, line_end)
+void atrous_rows(const atrous_pass &pass, int line_begin, int line_end) {
+    // B3 spline, the 1D kernel of the à-trous wavelet transform.
+    static const float kernel[5] = {1.0f/16, 1.0f/4, 3.0f/8, 1.0f/4, 1.0f/16};
+
+    for (int j = line_begin; j < line_end; j++) {
+        for (int i = 0; i < pass.width; i++) {
+            size_t p = 3 * (size_t(j) * pass.width + i);
+            float sum[3] = {0, 0, 0};
+            float weight_sum = 0;
+
+            for (int ky = -2; ky <= 2; ky++) {
+                int y = j + ky * pass.step;
+                if (y < 0 || y >= pass.height)
+                    continue;
+                for (int kx = -2; kx <= 2; kx++) {
+                    int x = i + kx * pass.step;
+                    if (x < 0 || x >= pass.width)
+                        continue;
+                    size_t q = 3 * (size_t(y) * pass.width + x);
+
+                    // The edge-stopping functions: taps are weighted less the
+                    // more they differ from the center pixel.
+                    float exponent = distance_squared(pass.in + p, pass.in + q) * pass.inv_color_var;
+                    if (pass.normal != nullptr) {
+                        exponent += distance_squared(pass.normal + p, pass.normal + q) * pass.inv_normal_var;
+                        exponent += distance_squared(pass.albedo + p, pass.albedo + q) * pass.inv_albedo_var;
+                    }
+                    float weight = kernel[kx + 2] * kernel[ky + 2] * std::exp(-exponent);
+
+                    sum[0] += weight * pass.in[q];
+                    sum[1] += weight * pass.in[q + 1];
+                    sum[2] += weight * pass.in[q + 2];
+                    weight_sum += weight;
+                }
+            }
+
+            // The center tap always has a weight > 0, so this can't be 0.
+            pass.out[p] = sum[0] / weight_sum;
+            pass.out[p + 1] = sum[1] / weight_sum;
+            pass.out[p + 2] = sum[2] / weight_sum;
+        }
+    }
+}
+
+// Runs 1 pass of the filter, split between n_threads threads.
+void atrous_mt(const atrous_pass &pass, int n_threads) {
+    if (n_threads == 1) {
+        atrous_rows(pass, 0, pass.height);
+        return;
+    }
+
+    std::vector<std::thread> thread_list;
+    auto block_size = pass.height / n_threads;
+    auto block_remainder = pass.height % n_threads; // Assigned to the last thread
+
+    int begin_idx = 0;
+    for (int tid = 0; tid < n_threads; tid++) {
+        int end_idx = begin_idx + block_size + (tid == n_threads - 1? block_remainder : 0);
+        thread_list.emplace_back(atrous_rows, std::cref(pass), begin_idx, end_idx);
+        begin_idx = end_idx;
+    }
+
+    for (auto &t: thread_list) {
+        t.join();
+    }
+}
+
+// Estimates the standard deviation of the noise in a (3 float per pixel)
+// image, from the median absolute difference between each pixel and the
+// average of its 4 neighbors (which is robust against edges).
+float estimate_noise(const float *image, int width, int height) {
+    if (width < 3 || height < 3)
+        return 0;
+
+    std::vector<float> diffs;
+    diffs.reserve(size_t(width - 2) * (height - 2));
+    for (int j = 1; j < height - 1; j++) {
+        for (int i = 1; i < width - 1; i++) {
+            size_t p = 3 * (size_t(j) * width + i);
+            size_t row = 3 * size_t(width);
+            float diff = 0;
+            for (int channel = 0; channel < 3; channel++) {
+                float neighbors = image[p + channel - 3] + image[p + channel + 3]
+                                  + image[p + channel - row] + image[p + channel + row];
+                diff += std::fabs(image[p + channel] - neighbors / 4);
+            }
+            diffs.push_back(diff / 3);
+        }
+    }
+
+    auto median = diffs.begin() + diffs.size() / 2;
+    std::nth_element(diffs.begin(), median, diffs.end());
+    // 0.6745 converts the median absolute deviation of a normal distribution
+    // to a standard deviation, and the difference has 1.25× the variance of
+    // a single pixel (1 + 4 * (1/4)^2).
+    return *median / 0.6745f / std::sqrt(1.25f);
+}
+
+}
+
+void rt::denoise(framebuffer &fb, int n_threads, const denoise_options &opts) {
+    if (n_threads < 0)
+        throw std::invalid_argument("The number of threads must be 0 or greater!");
+
+    int width = fb.get_image_width();
+    int height = fb.get_image_height();
+    size_t n_floats = 3 * size_t(width) * height;
+
+    if (n_threads == 0) {
+        n_threads = std::thread::hardware_concurrency();
+        if (n_threads == 0)
+            n_threads = 1;
+    }
+    if (n_threads > height)
+        n_threads = height;
+
+    float *color = fb.color_data.get();
+    const float *albedo = fb.albedo_data.get();
+    const float *normal = fb.normal_data.get();
+
+    // Divide out the albedo, so only the lighting gets filtered. Otherwise,
+    // the texture and color of surfaces would get blurred too.
+    if (fb.has_aux()) {
+        for (size_t index = 0; index < n_floats; index++)
+            color[index] /= std::fmax(albedo[index], MIN_ALBEDO);
+    }
+
+    // The color sigma is relative to the noise level, so images with little
+    // noise (like high sample counts) aren't blurred much.
+    float noise_sigma = std::fmax(estimate_noise(color, width, height), 1e-4f);
+
+    // The passes ping-pong between the color buffer and this one.
+    auto scratch = std::make_unique<float[]>(n_floats);
+    float *in = color;
+    float *out = scratch.get();
+
+    for (int iteration = 0; iteration < opts.iterations; iteration++) {
+        // The color sigma is halved each pass, as the noise is reduced.
+        float color_sigma = opts.color_sigma * noise_sigma / float(1 << iteration);
+        atrous_pass pass = {.in = in, .out = out,
+                            .albedo = albedo, .normal = normal,
+                            .width = width, .height = height,
+                            .step = 1 << iteration,
+                            .inv_color_var = 1 / (color_sigma * color_sigma),
+                            .inv_normal_var = 1 / (opts.normal_sigma * opts.normal_sigma),
+                            .inv_albedo_var = 1 / (opts.albedo_sigma * opts.albedo_sigma)};
+        atrous_mt(pass, n_threads);
+        std::swap(in, out);
+    }
+
+    // The last pass may have ended in the scratch buffer.
+    if (in != color) {
+        for (size_t index = 0; index < n_floats; index++)
+            color[index] = in[index];
+    }
+
+    if (fb.has_aux()) {
+        for (size_t index = 0; index < n_floats; index++)
+            color[index] *= std::fmax(albedo[index], MIN_ALBEDO);
+    }
+}
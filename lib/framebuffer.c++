@@ -0,0 +1,33 @@
+#include <rt/framebuffer.h>
+// For std::invalid_argument
+#include <stdexcept>
+
+using rt::bitmap;
+
+rt::framebuffer::framebuffer(int image_width, int image_height, bool with_aux) {
+    this->image_width = image_width;
+    this->image_height = image_height;
+    size_t n_floats = 3 * size_t(image_width) * image_height;
+    color_data = std::make_unique<float[]>(n_floats);
+    if (with_aux) {
+        albedo_data = std::make_unique<float[]>(n_floats);
+        normal_data = std::make_unique<float[]>(n_floats);
+    }
+}
+
+bitmap rt::framebuffer::to_bitmap(const rgb8_options &opts) const {
+    auto raw_bmp = bitmap(image_width, image_height);
+    convert_to(raw_bmp, opts);
+    return raw_bmp;
+}
+
+void rt::framebuffer::convert_to(bitmap &out, const rgb8_options &opts) const {
+    if (out.get_image_width() != image_width || out.get_image_height() != image_height)
+        throw std::invalid_argument("Bitmap size doesn't match the framebuffer");
+
+    for (int j = 0; j < image_height; j++) {
+        size_t index = pixel_index(j, 0);
+        linear_to_rgb8_row(color_data.get() + index, out.pixel_data.get() + index,
+                           image_width, j, opts);
+    }
+}
@@ -37,3 +37,10 @@ bool rt::hittable_list::hit(const ray &r, interval ray_t, hit_record &rec) const
 
     return hit_anything;
 }
+
+unsigned rt::hittable_list::material_kinds() const {
+    unsigned kinds = 0;
+    for (const auto &object : objects)
+        kinds |= object->material_kinds();
+    return kinds;
+}
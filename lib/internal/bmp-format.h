@@ -43,3 +43,38 @@ struct bmp_header {
 };
 
 #pragma pack(pop)
+
+/* Size of a row in the pixel table, which is padded to a multiple of 4 bytes.
+ * This assumes 24bpp.
+ */
+static inline uint64_t bmp_row_size(int32_t width) {
+    return ((uint64_t)width * 3 + 3) / 4 * 4;
+}
+
+/* Fills in a header for an uncompressed 24bpp image with the pixel table
+ * directly after it. A negative height means the rows are stored
+ * top-to-bottom. Sizes which don't fit in the 32-bit fields are set to 0
+ * (which readers are supposed to accept for uncompressed images).
+ * FIXME: This assumes little-endian.
+ */
+static inline struct bmp_header bmp_make_header(int32_t width, int32_t height) {
+    uint64_t rows = height < 0 ? -(int64_t)height : height;
+    uint64_t pxtable_size = bmp_row_size(width) * rows;
+    uint64_t file_size = pxtable_size + sizeof(struct bmp_header);
+    struct bmp_header hdr = {.type = 0x4d42,
+                             .bmp_size = file_size <= UINT32_MAX ? (int32_t)file_size : 0,
+                             .reserved_1 = 0, .reserved_2 = 0,
+                             .pixel_offset = sizeof(struct bmp_header),
+                             .hdr_size = 40, // Size of subheader
+                             .pixel_width = width,
+                             .pixel_height = height,
+                             .color_planes = 1, .bpp = 24,
+                             .compression_method = BI_RGB,
+                             .raw_image_size = pxtable_size <= UINT32_MAX ? (int32_t)pxtable_size : 0,
+                             // px/m, 3780 px/m is approx. 96 px/in
+                             .horiz_dpm = 3780, .vert_dpm = 3780,
+                             .color_palette_size = 0, // All colors
+                             .num_important_colors = 0 // Unimportant
+                            };
+    return hdr;
+}
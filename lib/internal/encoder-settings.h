@@ -0,0 +1,5 @@
+#pragma once
+// Settings shared by the whole-image (bitmap) and strip writers.
+
+// Quality definitions
+#define JPEG_QUALITY 95
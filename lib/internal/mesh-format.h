@@ -0,0 +1,38 @@
+#pragma once
+#ifdef __cplusplus
+#include <cstdint>
+#else
+#include <stdint.h>
+#endif
+
+// Magic bytes at the beginning of a binary mesh
+#define MESH_MAGIC "RTMESH\r\n"
+#define MESH_VERSION 1
+// Every section begins on a multiple of this, so it can be used in place.
+#define MESH_SECTION_ALIGN 64
+
+/* Binary mesh format, used in place after mapping it into memory.
+ * All integers and floats are little-endian.
+ * It is laid out as follows:
+ *  - This header (64 bytes)
+ *  - Vertex table: vertex_count * struct mesh_vertex (float x, y, z)
+ *  - Triangle table: triangle_count * struct mesh_triangle (uint32 v[3])
+ *  - BVH node table: node_count * struct mesh_bvh_node (32 bytes each)
+ * Each table is zero-padded to a multiple of MESH_SECTION_ALIGN bytes.
+ */
+struct mesh_header {
+    char magic[8]; // MESH_MAGIC, without the null terminator
+    uint32_t version; // MESH_VERSION
+    uint32_t header_size; // sizeof(struct mesh_header)
+    uint64_t vertex_count;
+    uint64_t triangle_count;
+    uint64_t node_count;
+    // Offsets from the beginning of file
+    uint64_t vertex_offset;
+    uint64_t triangle_offset;
+    uint64_t node_offset;
+};
+
+#ifdef __cplusplus
+static_assert(sizeof(struct mesh_header) == 64, "mesh_header must be 64 bytes");
+#endif
@@ -0,0 +1,192 @@
+#include <rt/mapped-file.h>
+
+// std::clog
+#include <iostream>
+
+#ifdef _WIN32
+// CreateFileA(), CreateFileMappingA(), MapViewOfFile(), etc.
+#include <windows.h>
+
+rt::mapped_file::mapped_file(const char *fname) {
+    HANDLE file = CreateFileA(fname, GENERIC_READ, FILE_SHARE_READ, nullptr,
+                              OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE) {
+        std::clog << "Failed to open " << fname << " (error " << GetLastError() << ")\n";
+        return;
+    }
+    file_handle = file;
+
+    LARGE_INTEGER file_size;
+    if (!GetFileSizeEx(file, &file_size) || file_size.QuadPart == 0) {
+        std::clog << "Can't map " << fname << ": it is empty or its size is unknown.\n";
+        return;
+    }
+
+    // Sizes of 0 mean "the whole file".
+    HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (mapping == nullptr) {
+        std::clog << "CreateFileMapping failed for " << fname
+                  << " (error " << GetLastError() << ")\n";
+        return;
+    }
+    mapping_handle = mapping;
+
+    void *view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    if (view == nullptr) {
+        std::clog << "MapViewOfFile failed for " << fname
+                  << " (error " << GetLastError() << ")\n";
+        return;
+    }
+    map_ptr = static_cast<uint8_t *>(view);
+    map_size = file_size.QuadPart;
+}
+
+rt::mapped_file::mapped_file(const char *fname, uint64_t size) {
+    HANDLE file = CreateFileA(fname, GENERIC_READ | GENERIC_WRITE, 0, nullptr,
+                              CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE) {
+        std::clog << "Failed to create " << fname << " (error " << GetLastError() << ")\n";
+        return;
+    }
+    file_handle = file;
+
+    if (size == 0) {
+        std::clog << "Can't map " << fname << " with a size of 0.\n";
+        return;
+    }
+
+    // Mapping with a size larger than the file extends the file. The new
+    // space is allocated right away (it isn't sparse), so this fails if the
+    // disk is full, instead of a later write to the view.
+    HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READWRITE,
+                                        DWORD(size >> 32), DWORD(size & 0xFFFFFFFF), nullptr);
+    if (mapping == nullptr) {
+        std::clog << "CreateFileMapping failed for " << fname
+                  << " (error " << GetLastError() << ")\n";
+        return;
+    }
+    mapping_handle = mapping;
+
+    void *view = MapViewOfFile(mapping, FILE_MAP_WRITE, 0, 0, 0);
+    if (view == nullptr) {
+        std::clog << "MapViewOfFile failed for " << fname
+                  << " (error " << GetLastError() << ")\n";
+        return;
+    }
+    map_ptr = static_cast<uint8_t *>(view);
+    map_size = size;
+    writable = true;
+}
+
+bool rt::mapped_file::flush() {
+    if (!writable)
+        return true;
+    // FlushViewOfFile() only starts the writes, FlushFileBuffers() waits for them.
+    if (!FlushViewOfFile(map_ptr, 0) || !FlushFileBuffers(file_handle)) {
+        std::clog << "Failed to write the mapped file back (error " << GetLastError() << ")\n";
+        return false;
+    }
+    return true;
+}
+
+rt::mapped_file::~mapped_file() {
+    if (map_ptr != nullptr)
+        UnmapViewOfFile(map_ptr);
+    if (mapping_handle != nullptr)
+        CloseHandle(mapping_handle);
+    if (file_handle != nullptr)
+        CloseHandle(file_handle);
+}
+
+#else
+// Unix-like systems have mmap()
+// open(), posix_fallocate()
+#include <fcntl.h>
+// mmap(), munmap(), msync()
+#include <sys/mman.h>
+// fstat()
+#include <sys/stat.h>
+// close(), ftruncate()
+#include <unistd.h>
+// strerror()
+#include <cstring>
+// errno
+#include <cerrno>
+
+rt::mapped_file::mapped_file(const char *fname) {
+    fd = open(fname, O_RDONLY);
+    if (fd < 0) {
+        std::clog << "Failed to open " << fname << ": " << strerror(errno) << '\n';
+        return;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size == 0) {
+        std::clog << "Can't map " << fname << ": it is empty or its size is unknown.\n";
+        return;
+    }
+
+    void *ptr = mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    if (ptr == MAP_FAILED) {
+        std::clog << "mmap() failed for " << fname << ": " << strerror(errno) << '\n';
+        return;
+    }
+    map_ptr = static_cast<uint8_t *>(ptr);
+    map_size = st.st_size;
+}
+
+rt::mapped_file::mapped_file(const char *fname, uint64_t size) {
+    fd = open(fname, O_RDWR | O_CREAT | O_TRUNC, 0666);
+    if (fd < 0) {
+        std::clog << "Failed to create " << fname << ": " << strerror(errno) << '\n';
+        return;
+    }
+
+    if (size == 0) {
+        std::clog << "Can't map " << fname << " with a size of 0.\n";
+        return;
+    }
+
+    // ftruncate() alone would leave the file sparse, and running out of space
+    // when a page is written back would crash with SIGBUS, so the space is
+    // reserved up front. Some filesystems can't do that, so those are left sparse.
+    int error = EOPNOTSUPP;
+#ifndef __APPLE__
+    // macOS doesn't have posix_fallocate().
+    error = posix_fallocate(fd, 0, off_t(size));
+#endif
+    if (error == EOPNOTSUPP || error == EINVAL)
+        error = (ftruncate(fd, off_t(size)) == 0)? 0 : errno;
+    if (error != 0) {
+        std::clog << "Failed to make " << fname << " " << size << " bytes long: "
+                  << strerror(error) << '\n';
+        return;
+    }
+
+    void *ptr = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (ptr == MAP_FAILED) {
+        std::clog << "mmap() failed for " << fname << ": " << strerror(errno) << '\n';
+        return;
+    }
+    map_ptr = static_cast<uint8_t *>(ptr);
+    map_size = size;
+    writable = true;
+}
+
+bool rt::mapped_file::flush() {
+    if (!writable)
+        return true;
+    if (msync(map_ptr, map_size, MS_SYNC) != 0) {
+        std::clog << "Failed to write the mapped file back: " << strerror(errno) << '\n';
+        return false;
+    }
+    return true;
+}
+
+rt::mapped_file::~mapped_file() {
+    if (map_ptr != nullptr)
+        munmap(map_ptr, map_size);
+    if (fd >= 0)
+        close(fd);
+}
+#endif // defined(_WIN32)
@@ -0,0 +1,181 @@
+#include <rt/preview.h>
+// For linear_to_rgb8_row()
+#include <rt/rgb8-convert.h>
+
+// For std::max(), std::min()
+#include <algorithm>
+// For std::chrono::steady_clock
+#include <chrono>
+#include <cstring>
+// For std::filesystem::rename()
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+// For std::invalid_argument
+#include <stdexcept>
+#include <string>
+// For std::unique_ptr<>
+#include <memory>
+
+using rt::bitmap;
+using rt::framebuffer;
+
+// The coarsest frames stop after one bounce, which is enough to show where
+// things are and their colors (glass looks dark until the 1/2 frame). Most
+// paths end within a few bounces anyway, so a cap of 4 made no difference, but
+// this takes the first frame from about 135 ms to 95 ms on my system.
+static constexpr int coarse_max_depth = 2;
+
+// Scales a coarse framebuffer up to the full size of out (nearest neighbor,
+// as it is only a preview).
+static void scale_up(const framebuffer &coarse, bitmap &out) {
+    int coarse_width = coarse.get_image_width();
+    int coarse_height = coarse.get_image_height();
+    int width = out.get_image_width();
+    int height = out.get_image_height();
+
+    // Each coarse line is converted once, then its pixels are repeated.
+    auto line = std::make_unique<uint8_t[]>(3 * size_t(coarse_width));
+    int converted_line = -1;
+
+    for (int j = 0; j < height; j++) {
+        int coarse_j = int(int64_t(j) * coarse_height / height);
+        if (coarse_j != converted_line) {
+            rt::linear_to_rgb8_row(coarse.color_data.get() + coarse.pixel_index(coarse_j, 0),
+                                   line.get(), coarse_width, coarse_j);
+            converted_line = coarse_j;
+        }
+
+        uint8_t *out_line = out.pixel_data.get() + 3 * size_t(j) * width;
+        for (int i = 0; i < width; i++) {
+            int coarse_i = int(int64_t(i) * coarse_width / width);
+            memcpy(out_line + 3 * i, line.get() + 3 * coarse_i, 3);
+        }
+    }
+}
+
+rt::previewer::previewer(const hittable &world, int n_threads, frame_callback on_frame)
+    : world(world), n_threads(n_threads), on_frame(std::move(on_frame)) {
+    if (n_threads < 0)
+        throw std::invalid_argument("The number of threads must be 0 or greater!");
+
+    worker = std::thread(&previewer::run, this);
+}
+
+rt::previewer::~previewer() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        quit = true;
+        cancel = true;
+    }
+    changed.notify_all();
+    worker.join();
+}
+
+void rt::previewer::update(const camera &cam) {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        pending.copy_settings(cam);
+        has_pending = true;
+        idle = false;
+        // The frame in progress is useless now.
+        cancel = true;
+    }
+    changed.notify_all();
+}
+
+void rt::previewer::wait_until_done() {
+    std::unique_lock<std::mutex> lock(mutex);
+    changed.wait(lock, [this]() { return idle; });
+}
+
+void rt::previewer::run() {
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            changed.wait(lock, [this]() { return has_pending || quit; });
+            if (quit)
+                return;
+            view.copy_settings(pending);
+            has_pending = false;
+            cancel = false;
+        }
+
+        refine();
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            // If there was an update() in the meantime, it isn't done yet.
+            if (!has_pending)
+                idle = true;
+        }
+        changed.notify_all();
+    }
+}
+
+void rt::previewer::refine() {
+    auto start = std::chrono::steady_clock::now();
+    auto seconds = [&]() {
+        return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    };
+
+    int full_width = std::max(view.image_width, 1);
+    int full_height = std::max(int(full_width / view.aspect_ratio), 1);
+    int target_samples = std::max(view.samples_per_pixel, 1);
+
+    auto image = bitmap(full_width, full_height);
+    // render_pass() sizes these itself.
+    auto fb = framebuffer(1, 1, false);
+
+    // Coarse levels only get 1 sample per pixel, they are replaced so fast
+    // that more wouldn't be worth it. The 1/8 and 1/4 ones are also limited to
+    // coarse_max_depth, then the full depth is used from 1/2 on.
+    camera coarse;
+    coarse.copy_settings(view);
+    for (int scale = 8; scale > 1; scale /= 2) {
+        coarse.image_width = std::max(full_width / scale, 1);
+        coarse.max_depth = (scale > 2)? std::min(view.max_depth, coarse_max_depth) : view.max_depth;
+        if (!coarse.render_pass(world, n_threads, fb, 0, 1, cancel))
+            return;
+
+        scale_up(fb, image);
+        on_frame(preview_frame{image, scale, 1, seconds(), false});
+    }
+
+    // Then full resolution, doubling the samples each time, so each frame
+    // takes about as long as everything before it.
+    int samples_done = 0;
+    while (samples_done < target_samples) {
+        int samples = std::clamp(samples_done, 1, target_samples - samples_done);
+        if (!view.render_pass(world, n_threads, fb, samples_done, samples, cancel))
+            return;
+        samples_done += samples;
+
+        fb.convert_to(image);
+        on_frame(preview_frame{image, 1, samples_done, seconds(), samples_done == target_samples});
+    }
+}
+
+rt::previewer::frame_callback rt::previewer::file_writer(const char *fname, BitmapOutput filetype) {
+    std::filesystem::path path(fname);
+    std::filesystem::path temp_path = path;
+    temp_path += ".part";
+
+    return [=](const preview_frame &frame) {
+        {
+            std::ofstream out(temp_path, std::ios_base::out
+                                         | std::ios_base::binary
+                                         | std::ios_base::trunc);
+            if (!out) {
+                std::clog << "Failed to open " << temp_path.string() << '\n';
+                return;
+            }
+            frame.image.write_to_file(out, filetype);
+        }
+
+        std::error_code error;
+        std::filesystem::rename(temp_path, path, error);
+        if (error)
+            std::clog << "Failed to replace " << path.string() << ": " << error.message() << '\n';
+    };
+}
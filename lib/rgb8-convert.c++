@@ -0,0 +1,193 @@
+#include <rt/rgb8-convert.h>
+
+// For std::min(), std::max()
+#include <algorithm>
+#include <cmath>
+// For std::unique_ptr<>
+#include <memory>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define HAVE_SSE2 1
+#include <emmintrin.h>
+#endif
+
+// Output bytes are floor(256 * sqrt(x)), clamped to [0, 255], which is what
+// write_pixel_vec3() does. That means byte k covers x in [k²/65536, (k+1)²/65536),
+// and since those edges are all multiples of 1/65536, a table indexed by
+// floor(x * 65536) is exact (and multiplying by 65536 doesn't round).
+static constexpr int lut_size = 65536;
+
+// The largest float below 1, so the table index can't go past the end.
+static constexpr float below_one = 1.0f - 1.0f / (1 << 24);
+
+// The table holds 256 * sqrt(index) (the output byte in 8.8 fixed point), so
+// the dither offset can be added before rounding down.
+static const uint16_t * gamma_table() {
+    static const std::unique_ptr<uint16_t[]> table = []() {
+        auto t = std::make_unique<uint16_t[]>(lut_size);
+        for (int index = 0; index < lut_size; index++)
+            t[index] = uint16_t(256 * std::sqrt(double(index)));
+        return t;
+    }();
+    return table.get();
+}
+
+static const uint8_t bayer8[8][8] = {
+    { 0, 32,  8, 40,  2, 34, 10, 42},
+    {48, 16, 56, 24, 50, 18, 58, 26},
+    {12, 44,  4, 36, 14, 46,  6, 38},
+    {60, 28, 52, 20, 62, 30, 54, 22},
+    { 3, 35, 11, 43,  1, 33,  9, 41},
+    {51, 19, 59, 27, 49, 17, 57, 25},
+    {15, 47,  7, 39, 13, 45,  5, 37},
+    {63, 31, 55, 23, 61, 29, 53, 21}
+};
+
+// The dither pattern repeats every 8 pixels (24 values), and blocks of 16
+// values start at offsets 0, 16 and 8 of it, so this is long enough to read
+// a whole block from any of them without wrapping.
+static constexpr int pattern_period = 24;
+static constexpr int pattern_size = pattern_period + 16;
+
+// Dither offsets for each value in a row, in 8.8 fixed point, between -0.5
+// and 0.5 (so the average brightness doesn't change), or all 0.
+static void fill_pattern(int32_t *pattern, int row, bool dither) {
+    for (int index = 0; index < pattern_size; index++) {
+        int column = (index % pattern_period) / 3;
+        pattern[index] = dither? 4 * bayer8[row & 7][column] + 2 - 128 : 0;
+    }
+}
+
+// Handles the values the SIMD loops didn't, or all of them without SSE2.
+static void convert_scalar(const float *in, uint8_t *out, size_t begin, size_t end,
+                           const int32_t *pattern, bool use_lut, bool dither) {
+    const uint16_t *table = use_lut? gamma_table() : nullptr;
+
+    // A division for every value would be slow, so the position in the pattern is kept separately.
+    size_t pattern_pos = begin % pattern_period;
+    for (size_t index = begin; index < end; index++) {
+        // This is written so NaNs become 0.
+        float value = in[index] > 0? in[index] : 0.0f;
+        int32_t offset = pattern[pattern_pos];
+        if (++pattern_pos == pattern_period)
+            pattern_pos = 0;
+        int32_t byte;
+        if (use_lut) {
+            int32_t fixed = table[int32_t(std::min(value, below_one) * lut_size)];
+            byte = (fixed + offset) >> 8;
+        } else if (dither) {
+            byte = int32_t(std::min(256 * std::sqrt(value) + offset / 256.0f, 255.0f));
+        } else {
+            byte = int32_t(std::min(256 * std::sqrt(value), 255.0f));
+            // sqrtf() can round up to the next byte just below an edge, but
+            // these are all exact in float, so the fix is easy.
+            float scaled = value * lut_size;
+            float byte_f = float(byte);
+            if (byte_f * byte_f > scaled)
+                byte--;
+            else if ((byte_f + 1) * (byte_f + 1) <= scaled)
+                byte++;
+        }
+        out[index] = uint8_t(std::clamp(byte, 0, 255));
+    }
+}
+
+#ifdef HAVE_SSE2
+// 16 values at a time, so each block ends up as one 16-byte store.
+static size_t convert_sse2(const float *in, uint8_t *out, size_t n_values,
+                           const int32_t *pattern, bool use_lut, bool dither) {
+    const __m128 zero = _mm_setzero_ps();
+    size_t index = 0;
+
+    if (use_lut) {
+        const uint16_t *table = gamma_table();
+        const __m128 max_value = _mm_set1_ps(below_one);
+        const __m128 scale = _mm_set1_ps(float(lut_size));
+        alignas(16) int32_t table_index[16];
+        alignas(16) int32_t fixed[16];
+
+        for (; index + 16 <= n_values; index += 16) {
+            const int32_t *offsets = pattern + index % pattern_period;
+            for (int part = 0; part < 4; part++) {
+                // _mm_max_ps() returns the second argument for NaNs.
+                __m128 value = _mm_max_ps(_mm_loadu_ps(in + index + 4 * part), zero);
+                value = _mm_min_ps(value, max_value);
+                _mm_store_si128(reinterpret_cast<__m128i *>(table_index + 4 * part),
+                                _mm_cvttps_epi32(_mm_mul_ps(value, scale)));
+            }
+            // SSE2 has no gather, but the table lookups are cheap next to the rest.
+            for (int part = 0; part < 16; part++)
+                fixed[part] = table[table_index[part]] + offsets[part];
+
+            __m128i v[4];
+            for (int part = 0; part < 4; part++)
+                v[part] = _mm_srai_epi32(_mm_load_si128(reinterpret_cast<__m128i *>(fixed + 4 * part)), 8);
+            // The saturating packs do the clamping to [0, 255].
+            __m128i low = _mm_packs_epi32(v[0], v[1]);
+            __m128i high = _mm_packs_epi32(v[2], v[3]);
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(out + index), _mm_packus_epi16(low, high));
+        }
+    } else if (dither) {
+        const __m128 max_value = _mm_set1_ps(255.0f);
+        const __m128 scale = _mm_set1_ps(256.0f);
+        const __m128 fixed_scale = _mm_set1_ps(1.0f / 256);
+
+        for (; index + 16 <= n_values; index += 16) {
+            const int32_t *offsets = pattern + index % pattern_period;
+            __m128i v[4];
+            for (int part = 0; part < 4; part++) {
+                __m128 value = _mm_max_ps(_mm_loadu_ps(in + index + 4 * part), zero);
+                __m128 offset = _mm_mul_ps(_mm_cvtepi32_ps(_mm_loadu_si128(
+                                    reinterpret_cast<const __m128i *>(offsets + 4 * part))), fixed_scale);
+                value = _mm_add_ps(_mm_mul_ps(_mm_sqrt_ps(value), scale), offset);
+                // Clamp before converting, as out of range values become INT_MIN.
+                value = _mm_min_ps(_mm_max_ps(value, zero), max_value);
+                v[part] = _mm_cvttps_epi32(value);
+            }
+            __m128i low = _mm_packs_epi32(v[0], v[1]);
+            __m128i high = _mm_packs_epi32(v[2], v[3]);
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(out + index), _mm_packus_epi16(low, high));
+        }
+    } else {
+        const __m128 max_value = _mm_set1_ps(255.0f);
+        const __m128 scale = _mm_set1_ps(256.0f);
+        const __m128 edge_scale = _mm_set1_ps(float(lut_size));
+        const __m128 one = _mm_set1_ps(1.0f);
+
+        for (; index + 16 <= n_values; index += 16) {
+            __m128i v[4];
+            for (int part = 0; part < 4; part++) {
+                __m128 value = _mm_max_ps(_mm_loadu_ps(in + index + 4 * part), zero);
+                __m128i byte = _mm_cvttps_epi32(_mm_min_ps(_mm_mul_ps(_mm_sqrt_ps(value), scale), max_value));
+                // Same fix as in convert_scalar(). Comparisons give -1 where
+                // they are true, so the mask is added to go down and
+                // subtracted to go up (256 is clamped by the pack below).
+                __m128 scaled = _mm_mul_ps(value, edge_scale);
+                __m128 byte_f = _mm_cvtepi32_ps(byte);
+                __m128 next_f = _mm_add_ps(byte_f, one);
+                byte = _mm_add_epi32(byte, _mm_castps_si128(_mm_cmpgt_ps(_mm_mul_ps(byte_f, byte_f), scaled)));
+                byte = _mm_sub_epi32(byte, _mm_castps_si128(_mm_cmple_ps(_mm_mul_ps(next_f, next_f), scaled)));
+                v[part] = byte;
+            }
+            __m128i low = _mm_packs_epi32(v[0], v[1]);
+            __m128i high = _mm_packs_epi32(v[2], v[3]);
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(out + index), _mm_packus_epi16(low, high));
+        }
+    }
+
+    return index;
+}
+#endif // defined(HAVE_SSE2)
+
+void rt::linear_to_rgb8_row(const float *in, uint8_t *out, int n_pixels, int row,
+                            const rgb8_options &opts) {
+    int32_t pattern[pattern_size];
+    fill_pattern(pattern, row, opts.dither);
+
+    size_t n_values = 3 * size_t(n_pixels);
+    size_t done = 0;
+#ifdef HAVE_SSE2
+    done = convert_sse2(in, out, n_values, pattern, opts.use_lut, opts.dither);
+#endif
+    convert_scalar(in, out, done, n_values, pattern, opts.use_lut, opts.dither);
+}
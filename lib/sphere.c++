@@ -1,4 +1,6 @@
 #include <rt/sphere.h>
+// For material::kind()
+#include <rt/material.h>
 
 using rt::ray;
 using rt::interval;
@@ -42,3 +44,7 @@ bool rt::sphere::hit(const ray &r, interval ray_t, hit_record &rec) const {
 
     return true;
 }
+
+unsigned rt::sphere::material_kinds() const {
+    return material_kind_bit(mat->kind());
+}
@@ -0,0 +1,407 @@
+#include <rt/strip-writer.h>
+// For .bmp header
+#include "bmp-format.h"
+// For JPEG_QUALITY
+#include "encoder-settings.h"
+// For std::vector
+#include <vector>
+// For memset()
+#include <cstring>
+
+// Determine what formats are supported.
+#include "rt-lib-config.h"
+
+using rt::strip_writer;
+using rt::BitmapOutput;
+
+namespace {
+
+// Writes text PPM, in the same form as bitmap::write_as_ppm().
+class ppm_strip_writer: public strip_writer {
+  public:
+    ppm_strip_writer(std::ostream &out): out(out) {}
+
+    bool begin(int image_width, int image_height) override {
+        width = image_width;
+        out << "P3\n" << image_width << ' ' << image_height << "\n255\n";
+        return bool(out);
+    }
+
+    bool write_rows(const uint8_t *rows, int n_rows) override {
+        size_t row_size = 3 * size_t(width);
+        for (int row = 0; row < n_rows; row++) {
+            // Rows are separated by a blank line.
+            if (rows_written > 0)
+                out << '\n';
+            const uint8_t *px = rows + row * row_size;
+            for (size_t index = 0; index < row_size; index += 3) {
+                // I have to convert to int or it will print as if an ASCII character.
+                out << int(px[index]) << ' ' << int(px[index + 1]) << ' '
+                    << int(px[index + 2]) << '\n';
+            }
+            rows_written++;
+        }
+        return bool(out);
+    }
+
+    bool finish() override {
+        out << std::flush;
+        return bool(out);
+    }
+
+  private:
+    std::ostream &out;
+    int width = 0;
+    int rows_written = 0;
+};
+
+// Writes a top-to-bottom BMP to a stream.
+class bmp_strip_writer: public strip_writer {
+  public:
+    bmp_strip_writer(std::ostream &out): out(out) {}
+
+    bool begin(int image_width, int image_height) override {
+        width = image_width;
+        // Negative image height causes it to be read top-to-bottom
+        struct bmp_header hdr = bmp_make_header(image_width, -image_height);
+        out.write(reinterpret_cast<char *>(&hdr), sizeof(hdr));
+        // Padding bytes stay zeroed.
+        row_buf.assign(bmp_row_size(image_width), 0);
+        return bool(out);
+    }
+
+    bool write_rows(const uint8_t *rows, int n_rows) override {
+        size_t row_size = 3 * size_t(width);
+        for (int row = 0; row < n_rows; row++) {
+            const uint8_t *px = rows + row * row_size;
+            // BMP is stored in BGR order.
+            for (size_t offset = 0; offset < row_size; offset += 3) {
+                row_buf[offset] = px[offset + 2];
+                row_buf[offset + 1] = px[offset + 1];
+                row_buf[offset + 2] = px[offset];
+            }
+            out.write(reinterpret_cast<char *>(row_buf.data()), row_buf.size());
+        }
+        return bool(out);
+    }
+
+    bool finish() override {
+        out << std::flush;
+        return bool(out);
+    }
+
+  private:
+    std::ostream &out;
+    int width = 0;
+    std::vector<uint8_t> row_buf;
+};
+
+// Writes a standard bottom-to-top BMP into a memory-mapped file.
+class mapped_bmp_strip_writer: public strip_writer {
+  public:
+    mapped_bmp_strip_writer(const char *fname): fname(fname) {}
+
+    bool begin(int image_width, int image_height) override {
+        width = image_width;
+        height = image_height;
+        row_size = bmp_row_size(image_width);
+
+        // Positive image height causes it to be read bottom-to-top
+        struct bmp_header hdr = bmp_make_header(image_width, image_height);
+        file = std::make_unique<rt::mapped_file>(fname, sizeof(hdr) + row_size * image_height);
+        if (!file->is_open())
+            return false;
+
+        memcpy(file->writable_data(), &hdr, sizeof(hdr));
+        return true;
+    }
+
+    bool write_rows(const uint8_t *rows, int n_rows) override {
+        // Anything past the last row would land outside the mapping.
+        if (n_rows < 0 || rows_written + n_rows > uint64_t(height)) {
+            std::clog << "Tried to write more rows than the image has.\n";
+            return false;
+        }
+        size_t rgb_row_size = 3 * size_t(width);
+        uint8_t *pixel_table = file->writable_data() + sizeof(struct bmp_header);
+        for (int row = 0; row < n_rows; row++, rows_written++) {
+            const uint8_t *px = rows + row * rgb_row_size;
+            // The top line of the image is the last row in the file.
+            uint8_t *dest = pixel_table + (height - 1 - rows_written) * row_size;
+            // BMP is stored in BGR order.
+            for (size_t offset = 0; offset < rgb_row_size; offset += 3) {
+                dest[offset] = px[offset + 2];
+                dest[offset + 1] = px[offset + 1];
+                dest[offset + 2] = px[offset];
+            }
+            memset(dest + rgb_row_size, 0, row_size - rgb_row_size);
+        }
+        return true;
+    }
+
+    bool finish() override {
+        // Unmapping would write out the changes too, but wouldn't say if that failed.
+        bool ok = file->flush();
+        file = nullptr;
+        return ok;
+    }
+
+  private:
+    const char *fname;
+    std::unique_ptr<rt::mapped_file> file;
+    int width = 0;
+    int height = 0;
+    uint64_t rows_written = 0;
+    uint64_t row_size = 0;
+};
+
+}
+
+// Implementations of optional writers.
+
+#ifdef ENABLE_PNG
+#include <png.h>
+// Needed for setjmp()/longjmp(), used for error handling.
+#include <csetjmp>
+
+namespace {
+
+// Callbacks for PNG writer to write to an ostream
+void png_strip_write_callback(png_structp png_ptr, png_bytep data, png_size_t len) {
+    std::ostream *out_ptr = (std::ostream *)png_get_io_ptr(png_ptr);
+    out_ptr->write(reinterpret_cast<char *>(data), len);
+}
+
+void png_strip_flush_callback(png_structp png_ptr) {
+    std::ostream *out_ptr = (std::ostream *)png_get_io_ptr(png_ptr);
+    (*out_ptr) << std::flush;
+}
+
+// Writes a PNG (with the same settings as bitmap::write_as_png()) row by row.
+class png_strip_writer: public strip_writer {
+  public:
+    png_strip_writer(std::ostream &out): out(out) {}
+
+    ~png_strip_writer() {
+        if (png_ptr != nullptr)
+            png_destroy_write_struct(&png_ptr, &info_ptr);
+    }
+
+    bool begin(int image_width, int image_height) override {
+        width = image_width;
+        png_ptr = png_create_write_struct(PNG_LIBPNG_VER_STRING, nullptr, nullptr, nullptr);
+        if (!png_ptr) {
+            std::clog << "Failed to initialize libpng writer\n";
+            return false;
+        }
+        info_ptr = png_create_info_struct(png_ptr);
+        if (!info_ptr) {
+            std::clog << "Failed to initialize libpng info structure\n";
+            return false;
+        }
+
+        // Note that setjmp() must be used every time a new function accesses libpng.
+        if (setjmp(png_jmpbuf(png_ptr))) {
+            std::clog << "Something happened while writing the PNG header.\n";
+            return false;
+        }
+
+        png_set_write_fn(png_ptr, png_voidp(&out), png_strip_write_callback, png_strip_flush_callback);
+        png_set_IHDR(png_ptr, info_ptr, image_width, image_height,
+                     8, // Bits per channel
+                     PNG_COLOR_TYPE_RGB, // 8bpc means 24bpp
+                     PNG_INTERLACE_NONE,
+                     PNG_COMPRESSION_TYPE_DEFAULT,
+                     PNG_FILTER_TYPE_DEFAULT);
+        // Set pixel density (in px/m)
+        png_set_pHYs(png_ptr, info_ptr, 3780, 3780, PNG_RESOLUTION_METER);
+        png_write_info(png_ptr, info_ptr);
+        return true;
+    }
+
+    bool write_rows(const uint8_t *rows, int n_rows) override {
+        if (setjmp(png_jmpbuf(png_ptr))) {
+            std::clog << "Something happened while writing the PNG file.\n";
+            return false;
+        }
+        for (int row = 0; row < n_rows; row++)
+            png_write_row(png_ptr, rows + row * 3 * size_t(width));
+        return true;
+    }
+
+    bool finish() override {
+        if (setjmp(png_jmpbuf(png_ptr))) {
+            std::clog << "Something happened while finishing the PNG file.\n";
+            return false;
+        }
+        png_write_end(png_ptr, info_ptr);
+        png_destroy_write_struct(&png_ptr, &info_ptr);
+        png_ptr = nullptr;
+        return bool(out);
+    }
+
+  private:
+    std::ostream &out;
+    int width = 0;
+    png_structp png_ptr = nullptr;
+    png_infop info_ptr = nullptr;
+};
+
+}
+#endif
+
+#ifdef ENABLE_LIBJPEG
+// Must be included before libjpeg headers
+#include <cstdio>
+#include <jpeglib.h>
+#include <jerror.h>
+
+// Size of the buffer for compressed data
+#define JPEG_OUT_BUF_SIZE 65536
+
+namespace {
+
+/* libjpeg destination which writes to an ostream as the buffer fills, so
+ * the compressed image doesn't have to be held in memory either.
+ */
+struct jpeg_ostream_dest {
+    struct jpeg_destination_mgr pub; // Must be first, libjpeg only sees this.
+    std::ostream *out;
+    JOCTET buffer[JPEG_OUT_BUF_SIZE];
+};
+
+void jpeg_ostream_init(j_compress_ptr j_comp) {
+    auto *dest = reinterpret_cast<jpeg_ostream_dest *>(j_comp->dest);
+    dest->pub.next_output_byte = dest->buffer;
+    dest->pub.free_in_buffer = JPEG_OUT_BUF_SIZE;
+}
+
+boolean jpeg_ostream_empty(j_compress_ptr j_comp) {
+    // libjpeg expects the whole buffer to be written, regardless of free_in_buffer.
+    auto *dest = reinterpret_cast<jpeg_ostream_dest *>(j_comp->dest);
+    dest->out->write(reinterpret_cast<char *>(dest->buffer), JPEG_OUT_BUF_SIZE);
+    dest->pub.next_output_byte = dest->buffer;
+    dest->pub.free_in_buffer = JPEG_OUT_BUF_SIZE;
+    return TRUE;
+}
+
+void jpeg_ostream_term(j_compress_ptr j_comp) {
+    auto *dest = reinterpret_cast<jpeg_ostream_dest *>(j_comp->dest);
+    dest->out->write(reinterpret_cast<char *>(dest->buffer),
+                     JPEG_OUT_BUF_SIZE - dest->pub.free_in_buffer);
+    (*dest->out) << std::flush;
+}
+
+// Writes a JPEG (with the same settings as bitmap::write_as_jpeg()) by scanlines.
+class jpeg_strip_writer: public strip_writer {
+  public:
+    jpeg_strip_writer(std::ostream &out) {
+        dest.out = &out;
+        dest.pub.init_destination = jpeg_ostream_init;
+        dest.pub.empty_output_buffer = jpeg_ostream_empty;
+        dest.pub.term_destination = jpeg_ostream_term;
+    }
+
+    ~jpeg_strip_writer() {
+        if (started)
+            jpeg_destroy_compress(&j_comp);
+    }
+
+    bool begin(int image_width, int image_height) override {
+        width = image_width;
+        j_comp.err = jpeg_std_error(&jerr); // Initialize error handling
+        jpeg_create_compress(&j_comp);
+        started = true;
+        j_comp.dest = &dest.pub;
+
+        j_comp.image_width = image_width;
+        j_comp.image_height = image_height;
+        j_comp.input_components = 3; // RGB
+        j_comp.in_color_space = JCS_RGB;
+        j_comp.data_precision = 8; // bpc
+
+        jpeg_set_defaults(&j_comp);
+        jpeg_set_quality(&j_comp, JPEG_QUALITY, true); // last arg limits to baseline JPEG
+        jpeg_start_compress(&j_comp, true); // True ensures a full JPEG
+        return bool(*dest.out);
+    }
+
+    bool write_rows(const uint8_t *rows, int n_rows) override {
+        for (int row = 0; row < n_rows; row++) {
+            // libjpeg doesn't take const rows, but it doesn't modify them.
+            JSAMPROW row_pointer = const_cast<JSAMPROW>(rows + row * 3 * size_t(width));
+            if (jpeg_write_scanlines(&j_comp, &row_pointer, 1) != 1) {
+                std::clog << "libjpeg failed to write a scanline.\n";
+                return false;
+            }
+        }
+        return bool(*dest.out);
+    }
+
+    bool finish() override {
+        jpeg_finish_compress(&j_comp);
+        jpeg_destroy_compress(&j_comp);
+        started = false;
+        return bool(*dest.out);
+    }
+
+  private:
+    struct jpeg_compress_struct j_comp;
+    struct jpeg_error_mgr jerr;
+    jpeg_ostream_dest dest;
+    bool started = false;
+    int width = 0;
+};
+
+}
+#endif
+
+bool strip_writer::type_is_supported(BitmapOutput filetype) {
+    switch (filetype) {
+      case BitmapOutput::PPM:
+        return true;
+        break;
+      case BitmapOutput::BMP:
+        return true;
+        break;
+#ifdef ENABLE_PNG
+      case BitmapOutput::PNG:
+        return true;
+        break;
+#endif
+      // TurboJPEG 3 can only compress whole images, so only libjpeg works here.
+#ifdef ENABLE_LIBJPEG
+      case BitmapOutput::JPEG:
+        return true;
+        break;
+#endif
+      // The lossless WebP encoder needs the whole image.
+      default:
+        return false;
+        break;
+    }
+}
+
+std::unique_ptr<strip_writer> strip_writer::create(std::ostream &out, BitmapOutput filetype) {
+    switch (filetype) {
+      case BitmapOutput::PPM:
+        return std::make_unique<ppm_strip_writer>(out);
+      case BitmapOutput::BMP:
+        return std::make_unique<bmp_strip_writer>(out);
+#ifdef ENABLE_PNG
+      case BitmapOutput::PNG:
+        return std::make_unique<png_strip_writer>(out);
+#endif
+#ifdef ENABLE_LIBJPEG
+      case BitmapOutput::JPEG:
+        return std::make_unique<jpeg_strip_writer>(out);
+#endif
+      default:
+        std::clog << "This file type can't be written a strip at a time!\n";
+        return nullptr;
+    }
+}
+
+std::unique_ptr<strip_writer> strip_writer::create_mapped_bmp(const char *fname) {
+    return std::make_unique<mapped_bmp_strip_writer>(fname);
+}
@@ -0,0 +1,685 @@
+#include <rt/triangle-mesh.h>
+// For std::clog
+#include <iostream>
+// For std::ifstream, used by the OBJ loader
+#include <fstream>
+// For std::from_chars()
+#include <charconv>
+// For std::string (holds the OBJ file contents)
+#include <string>
+// For std::partition(), std::nth_element()
+#include <algorithm>
+// For std::endian (the binary format is little-endian)
+#include <bit>
+// For memcmp(), memcpy()
+#include <cstring>
+// For std::invalid_argument
+#include <stdexcept>
+// For material::kind()
+#include <rt/material.h>
+
+// Binary mesh layout
+#include "mesh-format.h"
+
+using rt::ray;
+using rt::interval;
+using rt::hit_record;
+using rt::mesh_data;
+using rt::mesh_vertex;
+using rt::mesh_triangle;
+using rt::mesh_bvh_node;
+
+// Tuning for the BVH builder
+// Ranges this small always become a leaf.
+#define BVH_MIN_LEAF 2
+// Ranges up to this size become a leaf if the SAH says splitting doesn't help.
+#define BVH_MAX_LEAF 8
+#define BVH_SAH_BINS 16
+// Past this depth, ranges are split at the median to bound the tree depth.
+#define BVH_MAX_SAH_DEPTH 64
+// Deepest possible tree: BVH_MAX_SAH_DEPTH, then median splits of 2^32 triangles.
+#define BVH_STACK_SIZE (BVH_MAX_SAH_DEPTH + 33)
+
+// Internal functions
+
+namespace {
+
+// Bounding box used while building the BVH
+struct build_box {
+    float min[3] = {+INFINITY, +INFINITY, +INFINITY};
+    float max[3] = {-INFINITY, -INFINITY, -INFINITY};
+
+    void grow(const float p[3]) {
+        for (int axis = 0; axis < 3; axis++) {
+            min[axis] = std::fmin(min[axis], p[axis]);
+            max[axis] = std::fmax(max[axis], p[axis]);
+        }
+    }
+
+    void grow(const build_box &b) {
+        grow(b.min);
+        grow(b.max);
+    }
+
+    float half_area() const {
+        float dx = max[0] - min[0], dy = max[1] - min[1], dz = max[2] - min[2];
+        if (dx < 0)
+            return 0; // Empty
+        return dx * dy + dy * dz + dz * dx;
+    }
+};
+
+// Per-triangle data used while building the BVH
+struct build_prim {
+    build_box box;
+    float centroid[3];
+};
+
+struct bvh_builder {
+    std::vector<build_prim> prims;
+    std::vector<uint32_t> order; // Triangle index for each slot in the final order
+    std::vector<mesh_bvh_node> nodes;
+
+    void build(uint32_t node_idx, uint32_t begin, uint32_t end, int depth);
+};
+
+void bvh_builder::build(uint32_t node_idx, uint32_t begin, uint32_t end, int depth) {
+    build_box bounds, centroid_bounds;
+    for (uint32_t i = begin; i < end; i++) {
+        bounds.grow(prims[order[i]].box);
+        centroid_bounds.grow(prims[order[i]].centroid);
+    }
+
+    // I can't hold a reference into nodes, it gets reallocated by the children.
+    for (int axis = 0; axis < 3; axis++) {
+        nodes[node_idx].bounds_min[axis] = bounds.min[axis];
+        nodes[node_idx].bounds_max[axis] = bounds.max[axis];
+    }
+
+    uint32_t count = end - begin;
+    auto make_leaf = [&]() {
+        nodes[node_idx].offset = begin;
+        nodes[node_idx].count = count;
+        nodes[node_idx].axis = 0;
+    };
+
+    if (count <= BVH_MIN_LEAF) {
+        make_leaf();
+        return;
+    }
+
+    // Split along the axis where the centroids are spread out the most.
+    int axis = 0;
+    for (int a = 1; a < 3; a++) {
+        if (centroid_bounds.max[a] - centroid_bounds.min[a]
+            > centroid_bounds.max[axis] - centroid_bounds.min[axis])
+            axis = a;
+    }
+    float c_min = centroid_bounds.min[axis];
+    float c_extent = centroid_bounds.max[axis] - c_min;
+
+    uint32_t mid = begin;
+    if (c_extent > 0 && depth < BVH_MAX_SAH_DEPTH) {
+        // Binned surface area heuristic: sort the centroids into bins, then
+        // pick the bin boundary where (area * triangle count) is smallest.
+        build_box bin_box[BVH_SAH_BINS];
+        uint32_t bin_count[BVH_SAH_BINS] = {0};
+        float bin_scale = BVH_SAH_BINS / c_extent;
+        auto bin_of = [&](uint32_t prim) {
+            int bin = int((prims[prim].centroid[axis] - c_min) * bin_scale);
+            return std::min(bin, BVH_SAH_BINS - 1);
+        };
+
+        for (uint32_t i = begin; i < end; i++) {
+            int bin = bin_of(order[i]);
+            bin_count[bin]++;
+            bin_box[bin].grow(prims[order[i]].box);
+        }
+
+        // Cost of everything right of each boundary, swept right-to-left.
+        float right_cost[BVH_SAH_BINS];
+        build_box sweep;
+        uint32_t sweep_count = 0;
+        for (int bin = BVH_SAH_BINS - 1; bin > 0; bin--) {
+            sweep.grow(bin_box[bin]);
+            sweep_count += bin_count[bin];
+            right_cost[bin] = sweep.half_area() * sweep_count;
+        }
+
+        sweep = build_box();
+        sweep_count = 0;
+        int best_split = -1;
+        float best_cost = bounds.half_area() * count; // Cost of not splitting
+        for (int bin = 1; bin < BVH_SAH_BINS; bin++) {
+            sweep.grow(bin_box[bin - 1]);
+            sweep_count += bin_count[bin - 1];
+            float cost = sweep.half_area() * sweep_count + right_cost[bin];
+            if (cost < best_cost) {
+                best_cost = cost;
+                best_split = bin;
+            }
+        }
+
+        if (best_split < 0 && count <= BVH_MAX_LEAF) {
+            make_leaf();
+            return;
+        }
+        if (best_split > 0) {
+            auto split_it = std::partition(order.begin() + begin, order.begin() + end,
+                                           [&](uint32_t prim) {
+                                               return bin_of(prim) < best_split;
+                                           });
+            mid = split_it - order.begin();
+        }
+    }
+
+    if (mid == begin || mid == end) {
+        // No useful SAH split (or the centroids are all in one spot), so just
+        // split the range in half.
+        mid = begin + count / 2;
+        std::nth_element(order.begin() + begin, order.begin() + mid, order.begin() + end,
+                         [&](uint32_t a, uint32_t b) {
+                             return prims[a].centroid[axis] < prims[b].centroid[axis];
+                         });
+    }
+
+    // The first child directly follows this node, and the second follows the
+    // entire subtree of the first.
+    uint32_t first = nodes.size();
+    nodes.emplace_back();
+    build(first, begin, mid, depth + 1);
+    uint32_t second = nodes.size();
+    nodes.emplace_back();
+    build(second, mid, end, depth + 1);
+
+    nodes[node_idx].offset = second;
+    nodes[node_idx].count = 0;
+    nodes[node_idx].axis = axis;
+}
+
+// Writes zeros until the stream position is a multiple of MESH_SECTION_ALIGN.
+void pad_to_alignment(std::ostream &out, uint64_t &pos) {
+    static const char zeros[MESH_SECTION_ALIGN] = {0};
+    uint64_t padding = (MESH_SECTION_ALIGN - pos % MESH_SECTION_ALIGN) % MESH_SECTION_ALIGN;
+    out.write(zeros, padding);
+    pos += padding;
+}
+
+// Parses an OBJ face index ("7", "7/2", "7/2/3", "7//3", or negative versions)
+// and returns it 0-based. Returns -1 if it isn't a valid index.
+int64_t parse_obj_index(const char *&cur, const char *end, uint64_t n_vertices) {
+    int64_t index = 0;
+    auto result = std::from_chars(cur, end, index);
+    if (result.ec != std::errc())
+        return -1;
+    cur = result.ptr;
+    // Skip texture coordinate/normal indices, I don't use them.
+    while (cur < end && *cur != ' ' && *cur != '\t' && *cur != '\r' && *cur != '\n')
+        cur++;
+
+    // Negative indices count backwards from the latest vertex.
+    if (index < 0)
+        index += n_vertices;
+    else
+        index -= 1;
+
+    if (index < 0 || uint64_t(index) >= n_vertices)
+        return -1;
+    return index;
+}
+
+const char * skip_spaces(const char *cur, const char *end) {
+    while (cur < end && (*cur == ' ' || *cur == '\t'))
+        cur++;
+    return cur;
+}
+
+}
+
+// Mesh data
+
+mesh_data::mesh_data(std::vector<mesh_vertex> vertices, std::vector<mesh_triangle> triangles):
+    vertex_store(std::move(vertices)), triangle_store(std::move(triangles)) {
+    for (const auto &tri: triangle_store) {
+        if (tri.v[0] >= vertex_store.size()
+            || tri.v[1] >= vertex_store.size()
+            || tri.v[2] >= vertex_store.size())
+            throw std::invalid_argument("Mesh triangle refers to a vertex which doesn't exist!");
+    }
+    if (triangle_store.size() > UINT32_MAX)
+        throw std::invalid_argument("Meshes are limited to 2^32 - 1 triangles!");
+
+    build_bvh();
+
+    vertex_ptr = vertex_store.data();
+    triangle_ptr = triangle_store.data();
+    node_ptr = node_store.data();
+    n_vertices = vertex_store.size();
+    n_triangles = triangle_store.size();
+    n_nodes = node_store.size();
+}
+
+void mesh_data::build_bvh() {
+    uint32_t n_tris = triangle_store.size();
+    if (n_tris == 0)
+        return; // No nodes, nothing can hit it.
+
+    bvh_builder builder;
+    builder.prims.resize(n_tris);
+    builder.order.resize(n_tris);
+    for (uint32_t i = 0; i < n_tris; i++) {
+        auto &prim = builder.prims[i];
+        for (int corner = 0; corner < 3; corner++) {
+            const mesh_vertex &v = vertex_store[triangle_store[i].v[corner]];
+            float p[3] = {v.x, v.y, v.z};
+            prim.box.grow(p);
+        }
+        for (int axis = 0; axis < 3; axis++)
+            prim.centroid[axis] = 0.5f * (prim.box.min[axis] + prim.box.max[axis]);
+        builder.order[i] = i;
+    }
+
+    // A binary tree with at least 1 triangle per leaf has < 2n nodes.
+    builder.nodes.reserve(2 * size_t(n_tris));
+    builder.nodes.emplace_back();
+    builder.build(0, 0, n_tris, 0);
+
+    // Put the triangles in BVH order.
+    std::vector<mesh_triangle> sorted(n_tris);
+    for (uint32_t i = 0; i < n_tris; i++)
+        sorted[i] = triangle_store[builder.order[i]];
+    triangle_store = std::move(sorted);
+    node_store = std::move(builder.nodes);
+    node_store.shrink_to_fit();
+}
+
+std::shared_ptr<mesh_data> mesh_data::load_obj(const char *fname) {
+    std::ifstream in(fname, std::ios_base::in | std::ios_base::binary);
+    if (!in) {
+        std::clog << "Failed to open OBJ file " << fname << '\n';
+        return nullptr;
+    }
+    // Reading it all at once is much faster than going line-by-line.
+    std::string contents((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+
+    std::vector<mesh_vertex> vertices;
+    std::vector<mesh_triangle> triangles;
+
+    const char *cur = contents.data();
+    const char *end = cur + contents.size();
+    uint64_t line_num = 0;
+    while (cur < end) {
+        const char *line_end = static_cast<const char *>(memchr(cur, '\n', end - cur));
+        if (line_end == nullptr)
+            line_end = end;
+        line_num++;
+
+        cur = skip_spaces(cur, line_end);
+        if (line_end - cur > 2 && cur[0] == 'v' && (cur[1] == ' ' || cur[1] == '\t')) {
+            // Vertex: "v x y z [w]"
+            float coords[3];
+            cur += 2;
+            for (int axis = 0; axis < 3; axis++) {
+                cur = skip_spaces(cur, line_end);
+                auto result = std::from_chars(cur, line_end, coords[axis]);
+                if (result.ec != std::errc()) {
+                    std::clog << fname << ':' << line_num << ": Invalid vertex\n";
+                    return nullptr;
+                }
+                cur = result.ptr;
+            }
+            vertices.push_back({coords[0], coords[1], coords[2]});
+        } else if (line_end - cur > 2 && cur[0] == 'f' && (cur[1] == ' ' || cur[1] == '\t')) {
+            // Face: "f a b c [d...]", which is split into a fan of triangles.
+            int64_t first = -1, prev = -1;
+            int corner = 0;
+            cur += 2;
+            while (true) {
+                cur = skip_spaces(cur, line_end);
+                if (cur == line_end || *cur == '\r')
+                    break;
+                int64_t index = parse_obj_index(cur, line_end, vertices.size());
+                if (index < 0) {
+                    std::clog << fname << ':' << line_num << ": Invalid face index\n";
+                    return nullptr;
+                }
+                if (corner == 0)
+                    first = index;
+                else if (corner >= 2)
+                    triangles.push_back({{uint32_t(first), uint32_t(prev), uint32_t(index)}});
+                prev = index;
+                corner++;
+            }
+        }
+        // Everything else (normals, texture coordinates, groups, materials) is ignored.
+
+        cur = line_end + 1;
+    }
+
+    if (vertices.size() > UINT32_MAX) {
+        std::clog << fname << ": Too many vertices (the limit is 2^32 - 1)\n";
+        return nullptr;
+    }
+
+    // The constructor throws for meshes it can't hold (like too many triangles),
+    // but this returns nullptr for every failure.
+    try {
+        return std::make_shared<mesh_data>(std::move(vertices), std::move(triangles));
+    } catch (const std::invalid_argument &error) {
+        std::clog << fname << ": " << error.what() << '\n';
+        return nullptr;
+    }
+}
+
+std::shared_ptr<mesh_data> mesh_data::load_binary(const char *fname, bool trusted) {
+    if constexpr (std::endian::native != std::endian::little) {
+        // It is used in place, so there is no chance to byteswap it.
+        std::clog << "Binary meshes are only supported on little-endian systems.\n";
+        return nullptr;
+    }
+
+    auto file = std::make_unique<mapped_file>(fname);
+    if (!file->is_open())
+        return nullptr;
+
+    struct mesh_header hdr;
+    if (file->size() < sizeof(hdr)) {
+        std::clog << fname << " is too small to be a binary mesh.\n";
+        return nullptr;
+    }
+    memcpy(&hdr, file->data(), sizeof(hdr));
+
+    if (memcmp(hdr.magic, MESH_MAGIC, sizeof(hdr.magic)) != 0
+        || hdr.header_size != sizeof(hdr)) {
+        std::clog << fname << " is not a binary mesh.\n";
+        return nullptr;
+    }
+    if (hdr.version != MESH_VERSION) {
+        std::clog << fname << " has unsupported mesh version " << hdr.version << '\n';
+        return nullptr;
+    }
+
+    // Make sure each table is aligned and fits inside the file.
+    auto table_fits = [&](uint64_t offset, uint64_t count, uint64_t elem_size) {
+        if (offset % MESH_SECTION_ALIGN != 0 || offset > file->size())
+            return false;
+        return count <= (file->size() - offset) / elem_size;
+    };
+    if (!table_fits(hdr.vertex_offset, hdr.vertex_count, sizeof(mesh_vertex))
+        || !table_fits(hdr.triangle_offset, hdr.triangle_count, sizeof(mesh_triangle))
+        || !table_fits(hdr.node_offset, hdr.node_count, sizeof(mesh_bvh_node))
+        || (hdr.triangle_count > 0 && hdr.node_count == 0)) {
+        std::clog << fname << " is truncated or corrupt.\n";
+        return nullptr;
+    }
+
+    // The constructor is private, so I can't use std::make_shared<>() here.
+    std::shared_ptr<mesh_data> mesh(new mesh_data());
+    const uint8_t *base = file->data();
+    mesh->vertex_ptr = reinterpret_cast<const mesh_vertex *>(base + hdr.vertex_offset);
+    mesh->triangle_ptr = reinterpret_cast<const mesh_triangle *>(base + hdr.triangle_offset);
+    mesh->node_ptr = reinterpret_cast<const mesh_bvh_node *>(base + hdr.node_offset);
+    mesh->n_vertices = hdr.vertex_count;
+    mesh->n_triangles = hdr.triangle_count;
+    mesh->n_nodes = hdr.node_count;
+    mesh->mapping = std::move(file);
+
+    // triangle_mesh::hit() trusts the indices, so a bad one would read out of bounds.
+    if (!trusted && !mesh->validate()) {
+        std::clog << fname << " is corrupt.\n";
+        return nullptr;
+    }
+    return mesh;
+}
+
+bool mesh_data::validate() const {
+    for (uint64_t i = 0; i < n_triangles; i++) {
+        const mesh_triangle &tri = triangle_ptr[i];
+        if (tri.v[0] >= n_vertices || tri.v[1] >= n_vertices || tri.v[2] >= n_vertices) {
+            std::clog << "Mesh triangle " << i << " refers to a vertex which doesn't exist.\n";
+            return false;
+        }
+    }
+
+    if (n_nodes == 0) {
+        if (n_triangles > 0) {
+            std::clog << "Mesh has triangles but no BVH.\n";
+            return false;
+        }
+        return true;
+    }
+
+    /* Walk the tree the way build_bvh() lays it out: each node is followed by
+     * its first child's subtree, then its second child's. Checking that the
+     * second child starts right where the first subtree ends means every node
+     * is in the tree exactly once, so tracing a ray can't loop or visit shared
+     * subtrees over and over. This also keeps it shallow enough for the
+     * traversal stack in triangle_mesh::hit().
+     */
+    struct pending {
+        uint64_t node;
+        bool in_second_child;
+    };
+    std::vector<pending> parents;
+    uint64_t node_idx = 0;
+    while (true) {
+        if (node_idx >= n_nodes) {
+            std::clog << "BVH refers to nodes which don't exist.\n";
+            return false;
+        }
+        const mesh_bvh_node &node = node_ptr[node_idx];
+
+        if (node.count == 0) {
+            if (node.axis > 2) {
+                std::clog << "BVH node " << node_idx << " has an invalid split axis.\n";
+                return false;
+            }
+            if (parents.size() >= BVH_STACK_SIZE) {
+                std::clog << "BVH is too deep.\n";
+                return false;
+            }
+            parents.push_back({node_idx, false});
+            node_idx++;
+            continue;
+        }
+
+        if (uint64_t(node.offset) + node.count > n_triangles) {
+            std::clog << "BVH leaf " << node_idx << " refers to triangles which don't exist.\n";
+            return false;
+        }
+
+        // Go back up to the nearest parent still waiting on its second child.
+        uint64_t subtree_end = node_idx + 1;
+        while (!parents.empty() && parents.back().in_second_child)
+            parents.pop_back();
+        if (parents.empty()) {
+            if (subtree_end != n_nodes) {
+                std::clog << "BVH has nodes which aren't in the tree.\n";
+                return false;
+            }
+            return true;
+        }
+        if (node_ptr[parents.back().node].offset != subtree_end) {
+            std::clog << "BVH node " << parents.back().node << " is corrupt.\n";
+            return false;
+        }
+        parents.back().in_second_child = true;
+        node_idx = subtree_end;
+    }
+}
+
+bool mesh_data::write_binary(std::ostream &out) const {
+    if constexpr (std::endian::native != std::endian::little) {
+        std::clog << "Binary meshes are only supported on little-endian systems.\n";
+        return false;
+    }
+
+    struct mesh_header hdr;
+    memcpy(hdr.magic, MESH_MAGIC, sizeof(hdr.magic));
+    hdr.version = MESH_VERSION;
+    hdr.header_size = sizeof(hdr);
+    hdr.vertex_count = n_vertices;
+    hdr.triangle_count = n_triangles;
+    hdr.node_count = n_nodes;
+
+    // Work out where each table goes.
+    auto align = [](uint64_t pos) {
+        return (pos + MESH_SECTION_ALIGN - 1) / MESH_SECTION_ALIGN * MESH_SECTION_ALIGN;
+    };
+    hdr.vertex_offset = align(sizeof(hdr));
+    hdr.triangle_offset = align(hdr.vertex_offset + n_vertices * sizeof(mesh_vertex));
+    hdr.node_offset = align(hdr.triangle_offset + n_triangles * sizeof(mesh_triangle));
+
+    uint64_t pos = 0;
+    out.write(reinterpret_cast<const char *>(&hdr), sizeof(hdr));
+    pos += sizeof(hdr);
+
+    pad_to_alignment(out, pos);
+    out.write(reinterpret_cast<const char *>(vertex_ptr), n_vertices * sizeof(mesh_vertex));
+    pos += n_vertices * sizeof(mesh_vertex);
+
+    pad_to_alignment(out, pos);
+    out.write(reinterpret_cast<const char *>(triangle_ptr), n_triangles * sizeof(mesh_triangle));
+    pos += n_triangles * sizeof(mesh_triangle);
+
+    pad_to_alignment(out, pos);
+    out.write(reinterpret_cast<const char *>(node_ptr), n_nodes * sizeof(mesh_bvh_node));
+
+    if (!out) {
+        std::clog << "Failed to write binary mesh.\n";
+        return false;
+    }
+    return true;
+}
+
+// Triangle mesh
+
+bool rt::triangle_mesh::hit(const ray &r, interval ray_t, hit_record &rec) const {
+    if (data->node_count() == 0)
+        return false;
+
+    const mesh_vertex *verts = data->vertices();
+    const mesh_triangle *tris = data->triangles();
+    const mesh_bvh_node *nodes = data->nodes();
+
+    const point3 &orig = r.origin();
+    const vec3 &dir = r.direction();
+    const double inv_dir[3] = {1.0 / dir[0], 1.0 / dir[1], 1.0 / dir[2]};
+
+    /* Setup for the watertight ray/triangle test (Woop, Benthin, Wald 2013).
+     * The vertices are moved into a space where the ray starts at the origin
+     * and goes along +z, so the hit test becomes a 2D edge test in x/y.
+     * Because every edge is tested the same way from both of its triangles,
+     * rays can't slip through the gaps between neighbouring triangles.
+     */
+    int kz = 0;
+    if (std::fabs(dir[1]) > std::fabs(dir[kz]))
+        kz = 1;
+    if (std::fabs(dir[2]) > std::fabs(dir[kz]))
+        kz = 2;
+    int kx = (kz + 1) % 3;
+    int ky = (kx + 1) % 3;
+    // Swap to keep the winding order the same
+    if (dir[kz] < 0)
+        std::swap(kx, ky);
+    double shear_x = dir[kx] / dir[kz];
+    double shear_y = dir[ky] / dir[kz];
+    double shear_z = 1.0 / dir[kz];
+
+    double closest = ray_t.max;
+    int64_t hit_tri = -1;
+
+    uint32_t stack[BVH_STACK_SIZE];
+    int stack_size = 0;
+    uint32_t node_idx = 0;
+
+    while (true) {
+        const mesh_bvh_node &node = nodes[node_idx];
+
+        // Slab test against the node's box. NaN (from 0 * infinity) fails the
+        // comparisons, so it leaves t_near/t_far unchanged.
+        double t_near = ray_t.min, t_far = closest;
+        for (int axis = 0; axis < 3; axis++) {
+            double t0 = (node.bounds_min[axis] - orig[axis]) * inv_dir[axis];
+            double t1 = (node.bounds_max[axis] - orig[axis]) * inv_dir[axis];
+            if (inv_dir[axis] < 0)
+                std::swap(t0, t1);
+            t_near = t0 > t_near ? t0 : t_near;
+            // Slightly enlarged so rounding error can't miss a box edge.
+            t1 *= 1 + 4 * std::numeric_limits<double>::epsilon();
+            t_far = t1 < t_far ? t1 : t_far;
+        }
+
+        if (t_near <= t_far) {
+            if (node.count == 0) {
+                // Visit the child nearest to the ray first, save the other.
+                uint32_t near_child = node_idx + 1, far_child = node.offset;
+                if (dir[node.axis] < 0)
+                    std::swap(near_child, far_child);
+                // Trees from build_bvh() can't get this deep, but a corrupt
+                // binary mesh could. Its far subtree is skipped then.
+                if (stack_size < BVH_STACK_SIZE)
+                    stack[stack_size++] = far_child;
+                node_idx = near_child;
+                continue;
+            }
+
+            for (uint32_t i = node.offset; i < node.offset + node.count; i++) {
+                const mesh_vertex &v0 = verts[tris[i].v[0]];
+                const mesh_vertex &v1 = verts[tris[i].v[1]];
+                const mesh_vertex &v2 = verts[tris[i].v[2]];
+                // Vertices relative to ray origin
+                vec3 a = vec3(v0.x, v0.y, v0.z) - orig;
+                vec3 b = vec3(v1.x, v1.y, v1.z) - orig;
+                vec3 c = vec3(v2.x, v2.y, v2.z) - orig;
+
+                // Shear so the ray is along +z
+                double ax = a[kx] - shear_x * a[kz], ay = a[ky] - shear_y * a[kz];
+                double bx = b[kx] - shear_x * b[kz], by = b[ky] - shear_y * b[kz];
+                double cx = c[kx] - shear_x * c[kz], cy = c[ky] - shear_y * c[kz];
+
+                // Scaled barycentric coordinates (edge functions)
+                double eu = cx * by - cy * bx;
+                double ev = ax * cy - ay * cx;
+                double ew = bx * ay - by * ax;
+                // The ray must be on the same side of all edges.
+                if ((eu < 0 || ev < 0 || ew < 0) && (eu > 0 || ev > 0 || ew > 0))
+                    continue;
+                double det = eu + ev + ew;
+                if (det == 0)
+                    continue; // Ray is parallel to the triangle
+
+                double t = (eu * shear_z * a[kz] + ev * shear_z * b[kz] + ew * shear_z * c[kz]) / det;
+                if (ray_t.min < t && t < closest) {
+                    closest = t;
+                    hit_tri = i;
+                }
+            }
+        }
+
+        if (stack_size == 0)
+            break;
+        node_idx = stack[--stack_size];
+    }
+
+    if (hit_tri < 0)
+        return false;
+
+    const mesh_vertex &v0 = verts[tris[hit_tri].v[0]];
+    const mesh_vertex &v1 = verts[tris[hit_tri].v[1]];
+    const mesh_vertex &v2 = verts[tris[hit_tri].v[2]];
+    point3 p0(v0.x, v0.y, v0.z);
+    vec3 outward_normal = unit_vector(cross(point3(v1.x, v1.y, v1.z) - p0,
+                                            point3(v2.x, v2.y, v2.z) - p0));
+
+    rec.t = closest;
+    rec.p = r.at(rec.t);
+    rec.set_face_normal(r, outward_normal);
+    rec.mat = mat;
+
+    return true;
+}
+
+unsigned rt::triangle_mesh::material_kinds() const {
+    return material_kind_bit(mat->kind());
+}
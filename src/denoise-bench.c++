@@ -0,0 +1,114 @@
+// Benchmarks image quality versus samples per pixel, with and without the
+// denoiser, against a high-spp reference render.
+#include <rt/rtweekend.h>
+#include <rt/camera.h>
+#include <rt/hittable-list.h>
+#include <rt/material.h>
+#include <rt/sphere.h>
+#include <rt/denoise.h>
+#include <rt/quirks.h>
+
+#include <iostream>
+// For std::chrono::steady_clock
+#include <chrono>
+// For std::from_chars()
+#include <charconv>
+#include <cstring>
+
+using namespace rt;
+
+static double seconds_since(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+// Peak signal-to-noise ratio (in dB) of the 8-bit output compared to reference.
+static double psnr(const bitmap &image, const bitmap &reference, int width, int height) {
+    double squared_error = 0;
+    size_t n_bytes = 3 * size_t(width) * height;
+    for (size_t index = 0; index < n_bytes; index++) {
+        double diff = double(image.pixel_data[index]) - reference.pixel_data[index];
+        squared_error += diff * diff;
+    }
+    double mse = squared_error / n_bytes;
+    return 10 * std::log10(255.0 * 255.0 / mse);
+}
+
+// A smaller version of the final scene from raytracer.c++
+static hittable_list make_scene() {
+    hittable_list world;
+    std::srand(42);
+
+    world.add(make_shared<sphere>(point3(0, -1000, 0), 1000,
+                                  make_shared<lambertian>(color(.5, .5, .5))));
+    for (int a = -4; a < 4; a++) {
+        for (int b = -4; b < 4; b++) {
+            auto choose_mat = random_double();
+            point3 center(a + .9 * random_double(), .2, b + .9 * random_double());
+            shared_ptr<material> sphere_material;
+            if (choose_mat < .7)
+                sphere_material = make_shared<lambertian>(color::random() * color::random());
+            else if (choose_mat < .9)
+                sphere_material = make_shared<metal>(color::random(.5, 1), random_double(0, .5));
+            else
+                sphere_material = make_shared<dielectric>(1.5);
+            world.add(make_shared<sphere>(center, .2, sphere_material));
+        }
+    }
+    world.add(make_shared<sphere>(point3(0, 1, 0), 1.0, make_shared<dielectric>(1.5)));
+    world.add(make_shared<sphere>(point3(-4, 1, 0), 1.0, make_shared<lambertian>(color(.4, .2, .1))));
+    world.add(make_shared<sphere>(point3(4, 1, 0), 1.0, make_shared<metal>(color(.7, .6, .5), 0.0)));
+    return world;
+}
+
+int main(int argl, char **args) {
+    int reference_spp = 1024;
+    if (argl > 1) {
+        auto result = std::from_chars(args[1], args[1] + strlen(args[1]), reference_spp);
+        if (result.ec != std::errc() || reference_spp < 1) {
+            std::cerr << "usage: " << args[0] << " [REFERENCE_SPP]\n";
+            return 1;
+        }
+    }
+
+    // Progress output would get in the way of the results.
+    line_printer = [](int) {};
+    done_printer = []() {};
+    std::clog.setstate(std::ios_base::badbit);
+
+    auto world = make_scene();
+
+    camera cam;
+    cam.aspect_ratio = 16.0 / 9.0;
+    cam.image_width = 400;
+    cam.max_depth = 50;
+    cam.vfov = 20;
+    cam.lookfrom = point3(13, 2, 3);
+    cam.lookat = point3(0, 0, 0);
+    cam.vup = vec3(0, 1, 0);
+    cam.defocus_angle = .6;
+    cam.focus_dist = 10.0;
+
+    std::cout << "Rendering reference at " << reference_spp << " spp...\n";
+    cam.samples_per_pixel = reference_spp;
+    auto reference_fb = cam.render_linear(world, 0, false);
+    auto reference = reference_fb.to_bitmap();
+    int width = reference_fb.get_image_width();
+    int height = reference_fb.get_image_height();
+
+    std::cout << "spp\trender s\tPSNR dB\tdenoise ms\tdenoised PSNR dB\n";
+    for (int spp = 4; spp <= 64 && spp < reference_spp; spp *= 2) {
+        cam.samples_per_pixel = spp;
+        auto start = std::chrono::steady_clock::now();
+        auto fb = cam.render_linear(world, 0, true);
+        double render_time = seconds_since(start);
+        double noisy_psnr = psnr(fb.to_bitmap(), reference, width, height);
+
+        start = std::chrono::steady_clock::now();
+        denoise(fb, 0);
+        double denoise_time = seconds_since(start);
+        double denoised_psnr = psnr(fb.to_bitmap(), reference, width, height);
+
+        std::cout << spp << '\t' << render_time << '\t' << noisy_psnr << '\t'
+                  << denoise_time * 1000 << '\t' << denoised_psnr << std::endl;
+    }
+}
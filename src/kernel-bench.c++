@@ -0,0 +1,542 @@
+// Microbenchmarks for the inner-loop kernels (intersection, scattering, vec3
+// helpers and pixel conversion), each run over large pre-generated inputs
+// from a fixed seed, so runs can be compared against each other.
+#include <rt/rtweekend.h>
+#include <rt/hittable-list.h>
+#include <rt/material.h>
+#include <rt/sphere.h>
+#include <rt/bitmap.h>
+#include <rt/rgb8-convert.h>
+#include <rt/camera.h>
+#include <rt/framebuffer.h>
+
+#include <iostream>
+// For std::ifstream, std::ofstream
+#include <fstream>
+// For std::chrono::steady_clock
+#include <chrono>
+// For std::mt19937
+#include <random>
+// For std::from_chars()
+#include <charconv>
+#include <cstring>
+#include <string>
+#include <string_view>
+#include <vector>
+// For std::min()
+#include <algorithm>
+// For std::setw()
+#include <iomanip>
+// For std::unique_ptr<>
+#include <memory>
+
+#ifdef __linux__
+// For perf_event_open()
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+using namespace rt;
+
+// Inputs are indexed modulo this. It is big enough that the kernels don't
+// just see the same few inputs (and branches) over and over.
+static constexpr size_t n_inputs = 1 << 14;
+static constexpr unsigned seed = 12345;
+
+struct options {
+    const char *filter = nullptr; // Only run kernels whose names contain this
+    const char *json_out = nullptr;
+    const char *baseline = nullptr;
+    double threshold = 10; // Percentage slowdown that counts as a regression
+    double min_time = 0.05; // Seconds per repetition
+    int repetitions = 5;
+    bool counters = false;
+};
+
+struct result {
+    std::string name;
+    double ns_per_op;
+    // Hardware counters per op, or negative if unavailable.
+    double cycles = -1, instructions = -1, branch_misses = -1, cache_misses = -1;
+};
+
+#ifdef __linux__
+// Cycles, instructions, branch misses and cache misses through perf_event_open(),
+// read as one group. Not being allowed to use them (perf_event_paranoid) is
+// common, so failures just turn them off.
+class perf_counters {
+  public:
+    perf_counters() {
+        const uint64_t configs[n_events] = {PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS,
+                                            PERF_COUNT_HW_BRANCH_MISSES, PERF_COUNT_HW_CACHE_MISSES};
+        for (int event = 0; event < n_events; event++) {
+            perf_event_attr attr;
+            memset(&attr, 0, sizeof(attr));
+            attr.size = sizeof(attr);
+            attr.type = PERF_TYPE_HARDWARE;
+            attr.config = configs[event];
+            attr.disabled = (event == 0);
+            attr.exclude_kernel = 1;
+            attr.exclude_hv = 1;
+            attr.read_format = PERF_FORMAT_GROUP;
+            fds[event] = syscall(SYS_perf_event_open, &attr, 0, -1, event == 0? -1 : fds[0], 0);
+            if (fds[event] < 0) {
+                std::clog << "Hardware counters are unavailable (" << strerror(errno) << ")\n";
+                close_all();
+                return;
+            }
+        }
+    }
+
+    ~perf_counters() {
+        close_all();
+    }
+
+    bool is_open() const {
+        return fds[0] >= 0;
+    }
+
+    void start() {
+        ioctl(fds[0], PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+        ioctl(fds[0], PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+    }
+
+    // Stops counting and divides the counts by n_ops into res.
+    void stop(result &res, double n_ops) {
+        ioctl(fds[0], PERF_EVENT_IOC_DISABLE, PERF_IOC_FLAG_GROUP);
+        // The group format is the number of events, then each value.
+        uint64_t values[1 + n_events];
+        if (read(fds[0], values, sizeof(values)) != ssize_t(sizeof(values)))
+            return;
+        res.cycles = values[1] / n_ops;
+        res.instructions = values[2] / n_ops;
+        res.branch_misses = values[3] / n_ops;
+        res.cache_misses = values[4] / n_ops;
+    }
+
+  private:
+    static constexpr int n_events = 4;
+    int fds[n_events] = {-1, -1, -1, -1};
+
+    void close_all() {
+        for (int &fd: fds) {
+            if (fd >= 0)
+                close(fd);
+            fd = -1;
+        }
+    }
+};
+#else
+// Hardware counters are only implemented on Linux.
+class perf_counters {
+  public:
+    perf_counters() {
+        std::clog << "Hardware counters are only supported on Linux.\n";
+    }
+    bool is_open() const { return false; }
+    void start() {}
+    void stop(result &, double) {}
+};
+#endif // defined(__linux__)
+
+// Results are added to this sink, so the compiler can't throw the work away.
+static volatile double sink;
+
+// Runs kernel(index) for index over the inputs (wrapping around), enough times
+// that each repetition takes at least opts.min_time, and keeps the fastest
+// repetition. kernel is a template parameter so it is inlined into the loop.
+template <typename kernel_fn>
+static void measure(std::vector<result> &results, const options &opts, perf_counters *counters,
+                    const char *name, kernel_fn &&kernel) {
+    if (opts.filter != nullptr && strstr(name, opts.filter) == nullptr)
+        return;
+
+    // The library random generator is reseeded too, for the kernels which use it.
+    std::srand(seed);
+
+    auto run = [&](size_t n_ops) {
+        double total = 0;
+        auto start = std::chrono::steady_clock::now();
+        for (size_t op = 0; op < n_ops; op++)
+            total += kernel(op % n_inputs);
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        sink = sink + total;
+        return seconds;
+    };
+
+    // Double the count until it takes long enough.
+    size_t n_ops = n_inputs;
+    while (run(n_ops) < opts.min_time && n_ops < (size_t(1) << 40))
+        n_ops *= 2;
+
+    result res{name, 0};
+    double best = run(n_ops);
+    for (int rep = 1; rep < opts.repetitions; rep++)
+        best = std::min(best, run(n_ops));
+    res.ns_per_op = best * 1e9 / n_ops;
+
+    if (counters != nullptr && counters->is_open()) {
+        counters->start();
+        run(n_ops);
+        counters->stop(res, double(n_ops));
+    }
+
+    std::cout << std::left << std::setw(46) << name << std::right << std::fixed
+              << std::setprecision(2) << std::setw(10) << res.ns_per_op << " ns/op"
+              << std::setprecision(1) << std::setw(12) << 1000 / res.ns_per_op << " Mops/s";
+    if (res.cycles >= 0) {
+        std::cout << std::setprecision(1) << std::setw(9) << res.cycles << " cyc"
+                  << std::setw(9) << res.instructions << " ins"
+                  << std::setprecision(3) << std::setw(9) << res.branch_misses << " br-miss"
+                  << std::setw(9) << res.cache_misses << " $-miss";
+    }
+    std::cout << std::endl;
+
+    results.push_back(res);
+}
+
+// Random inputs for the kernels, all from the same seed.
+struct inputs {
+    std::vector<ray> rays;
+    std::vector<hit_record> hits;
+    std::vector<vec3> unit_vectors;
+    std::vector<vec3> normals; // Facing against unit_vectors
+    std::vector<float> colors; // 3 per pixel, for the pixel conversions
+
+    inputs() {
+        std::mt19937 gen(seed);
+        std::uniform_real_distribution<double> unit(-1, 1);
+        auto random_unit = [&]() {
+            while (true) {
+                vec3 p(unit(gen), unit(gen), unit(gen));
+                double len_squared = p.length_squared();
+                if (1e-6 < len_squared && len_squared <= 1)
+                    return p / std::sqrt(len_squared);
+            }
+        };
+
+        for (size_t index = 0; index < n_inputs; index++) {
+            // Rays start around (0, 1, 8) and point at the scene around the
+            // origin, so some of them hit and some miss.
+            point3 origin(unit(gen) * 2, 1 + unit(gen), 8 + unit(gen));
+            point3 target(unit(gen) * 6, unit(gen) * 1.5, unit(gen) * 6);
+            rays.emplace_back(origin, target - origin);
+
+            vec3 normal = random_unit();
+            vec3 incoming = random_unit();
+            if (dot(incoming, normal) > 0)
+                incoming = -incoming;
+            unit_vectors.push_back(incoming);
+            normals.push_back(normal);
+
+            hit_record rec;
+            rec.p = point3(unit(gen), unit(gen), unit(gen));
+            rec.t = 1 + unit(gen);
+            // Dielectrics are hit from both sides.
+            rec.set_face_normal(ray(rec.p - incoming, incoming), gen() % 4 == 0? -normal : normal);
+            hits.push_back(rec);
+        }
+
+        // Mostly dark values, like a linear render (some are out of range).
+        std::uniform_real_distribution<float> channel(-0.05f, 1.1f);
+        for (size_t index = 0; index < 3 * n_inputs; index++) {
+            float value = channel(gen);
+            colors.push_back(value * value);
+        }
+    }
+};
+
+// A diffuse material which isn't one of the built-in ones, so the renderer
+// has to call it through the virtual scatter().
+class custom_diffuse: public material {
+  public:
+    custom_diffuse(const color &albedo): albedo(albedo) {}
+
+    bool scatter([[maybe_unused]] const ray &r_in, const hit_record &rec,
+                 color &attenuation, ray &scattered) const override {
+        auto scatter_direction = rec.normal + random_unit_vector();
+        if (scatter_direction.near_zero())
+            scatter_direction = rec.normal;
+        scattered = ray(rec.p, scatter_direction);
+        attenuation = albedo;
+        return true;
+    }
+
+  private:
+    color albedo;
+};
+
+// Which materials make_scene() uses, one for each set the camera specializes for.
+enum class scene_materials { diffuse, builtin, custom };
+
+// A scene like the final one in raytracer.c++ (a ground sphere, 3 big ones and
+// (2 * half_size)² small ones around them). With diffuse, every material is
+// lambertian, and with custom, the shiny ones are replaced by custom_diffuse.
+static hittable_list make_scene(std::mt19937 &gen, int half_size, scene_materials materials) {
+    std::uniform_real_distribution<double> random(0, 1);
+    shared_ptr<material> diffuse = make_shared<lambertian>(color(.5, .5, .5));
+    shared_ptr<material> shiny = diffuse;
+    shared_ptr<material> glass = diffuse;
+    if (materials == scene_materials::builtin) {
+        shiny = make_shared<metal>(color(.7, .6, .5), .2);
+        glass = make_shared<dielectric>(1.5);
+    } else if (materials == scene_materials::custom) {
+        shiny = make_shared<custom_diffuse>(color(.7, .6, .5));
+        glass = make_shared<dielectric>(1.5);
+    }
+    hittable_list world;
+    world.add(make_shared<sphere>(point3(0, -1000, 0), 1000, diffuse));
+    for (int a = -half_size; a < half_size; a++) {
+        for (int b = -half_size; b < half_size; b++) {
+            double choose_mat = random(gen);
+            auto &mat = (choose_mat < .8)? diffuse : (choose_mat < .95)? shiny : glass;
+            world.add(make_shared<sphere>(point3(a + .9 * random(gen), .2, b + .9 * random(gen)), .2, mat));
+        }
+    }
+    world.add(make_shared<sphere>(point3(0, 1, 0), 1.0, glass));
+    world.add(make_shared<sphere>(point3(-4, 1, 0), 1.0, diffuse));
+    world.add(make_shared<sphere>(point3(4, 1, 0), 1.0, shiny));
+    return world;
+}
+
+// Sets up a small camera for the render kernel benchmarks (32x16 pixels, so a
+// pass at 1 sample per pixel divides the inputs evenly).
+static void setup_camera(camera &cam, bool defocus, bool specialize) {
+    cam.aspect_ratio = 2.0;
+    cam.image_width = 32;
+    cam.max_depth = 50;
+    cam.vfov = 20;
+    cam.lookfrom = point3(13, 2, 3);
+    cam.lookat = point3(0, 0, 0);
+    cam.vup = vec3(0, 1, 0);
+    cam.defocus_angle = defocus? .6 : 0;
+    cam.focus_dist = 10.0;
+    cam.specialize = specialize;
+}
+
+static void write_json(const char *fname, const std::vector<result> &results) {
+    std::ofstream out(fname, std::ios_base::out | std::ios_base::trunc);
+    out << "{\n  \"kernels\": {\n" << std::setprecision(6);
+    for (size_t index = 0; index < results.size(); index++) {
+        const result &res = results[index];
+        out << "    \"" << res.name << "\": {\"ns_per_op\": " << res.ns_per_op
+            << ", \"ops_per_sec\": " << 1e9 / res.ns_per_op;
+        if (res.cycles >= 0) {
+            out << ", \"cycles\": " << res.cycles << ", \"instructions\": " << res.instructions
+                << ", \"branch_misses\": " << res.branch_misses
+                << ", \"cache_misses\": " << res.cache_misses;
+        }
+        out << '}' << (index + 1 < results.size()? ",\n" : "\n");
+    }
+    out << "  }\n}\n";
+    if (!out)
+        std::clog << "Failed to write " << fname << '\n';
+}
+
+// Finds ns_per_op for name in a file written by write_json(). This isn't a
+// general JSON parser, it only has to read back what write_json() writes.
+static double baseline_ns_per_op(const std::string &json, const std::string &name) {
+    size_t pos = json.find('"' + name + "\":");
+    if (pos == std::string::npos)
+        return -1;
+    std::string_view key = "\"ns_per_op\":";
+    pos = json.find(key, pos);
+    if (pos == std::string::npos)
+        return -1;
+    pos += key.size();
+    while (pos < json.size() && json[pos] == ' ')
+        pos++;
+
+    double value = -1;
+    std::from_chars(json.data() + pos, json.data() + json.size(), value);
+    return value;
+}
+
+// Returns the number of kernels that got slower than the threshold.
+static int compare(const char *fname, const std::vector<result> &results, double threshold) {
+    std::ifstream in(fname);
+    if (!in) {
+        std::clog << "Failed to open baseline " << fname << '\n';
+        return -1;
+    }
+    std::string json((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+
+    int regressions = 0;
+    std::cout << "\nCompared to " << fname << " (threshold " << threshold << "%):\n";
+    for (const result &res: results) {
+        double base = baseline_ns_per_op(json, res.name);
+        std::cout << std::left << std::setw(46) << res.name << std::right;
+        if (base <= 0) {
+            std::cout << "  (not in baseline)\n";
+            continue;
+        }
+        double change = (res.ns_per_op / base - 1) * 100;
+        bool regressed = change > threshold;
+        regressions += regressed;
+        std::cout << std::fixed << std::setprecision(2) << std::setw(10) << base << " -> "
+                  << res.ns_per_op << " ns/op (" << std::showpos << std::setprecision(1)
+                  << change << std::noshowpos << "%)" << (regressed? "  REGRESSION\n" : "\n");
+    }
+    return regressions;
+}
+
+static void print_usage(const char *progname) {
+    std::clog << "usage: " << progname << " [-f NAME] [-o FILE.json] [-c BASELINE.json] "
+                 "[-t PERCENT] [-m SECONDS] [-p]\n"
+                 "  -f NAME      Only run kernels whose names contain NAME\n"
+                 "  -o FILE      Write the results as JSON\n"
+                 "  -c FILE      Compare against results saved with -o, and fail if any\n"
+                 "               kernel is slower by more than the threshold\n"
+                 "  -t PERCENT   Regression threshold (default 10)\n"
+                 "  -m SECONDS   Minimum time per repetition (default 0.05)\n"
+                 "  -p           Read hardware counters (Linux perf_event_open())\n";
+}
+
+int main(int argl, char **args) {
+    options opts;
+    for (int index = 1; index < argl; index++) {
+        std::string_view arg = args[index];
+        bool has_value = index + 1 < argl;
+        if (arg == "-f" && has_value) {
+            opts.filter = args[++index];
+        } else if (arg == "-o" && has_value) {
+            opts.json_out = args[++index];
+        } else if (arg == "-c" && has_value) {
+            opts.baseline = args[++index];
+        } else if ((arg == "-t" || arg == "-m") && has_value) {
+            const char *value = args[++index];
+            double &target = (arg == "-t")? opts.threshold : opts.min_time;
+            auto [ptr, err] = std::from_chars(value, value + strlen(value), target);
+            if (err != std::errc() || target < 0) {
+                std::clog << "Invalid number: " << value << '\n';
+                return 1;
+            }
+        } else if (arg == "-p") {
+            opts.counters = true;
+        } else {
+            print_usage(args[0]);
+            return (arg == "-h" || arg == "--help")? 0 : 1;
+        }
+    }
+
+    std::unique_ptr<perf_counters> counters;
+    if (opts.counters)
+        counters = std::make_unique<perf_counters>();
+
+    inputs in;
+    std::mt19937 scene_gen(seed);
+    hittable_list world = make_scene(scene_gen, 11, scene_materials::diffuse);
+    hittable_list small_mixed = make_scene(scene_gen, 3, scene_materials::builtin);
+    hittable_list small_diffuse = make_scene(scene_gen, 3, scene_materials::diffuse);
+    hittable_list small_custom = make_scene(scene_gen, 3, scene_materials::custom);
+    sphere ball(point3(0, 0, 0), 2, make_shared<lambertian>(color(.5, .5, .5)));
+    lambertian diffuse(color(.4, .2, .1));
+    metal shiny(color(.7, .6, .5), .3);
+    dielectric glass(1.5);
+    bitmap image(128, n_inputs / 128);
+    auto image_row = std::make_unique<uint8_t[]>(3 * n_inputs);
+
+    std::vector<result> results;
+    std::cout << std::left << std::setw(46) << "Kernel" << std::right << std::setw(16) << "Time"
+              << std::setw(19) << "Throughput\n";
+
+    measure(results, opts, counters.get(), "sphere::hit", [&](size_t index) {
+        hit_record rec;
+        return ball.hit(in.rays[index], interval(0.001, infinity), rec)? rec.t : 0.0;
+    });
+    std::string list_name = "hittable_list::hit (" + std::to_string(world.objects.size()) + " spheres)";
+    measure(results, opts, counters.get(), list_name.c_str(), [&](size_t index) {
+        hit_record rec;
+        return world.hit(in.rays[index], interval(0.001, infinity), rec)? rec.t : 0.0;
+    });
+    measure(results, opts, counters.get(), "lambertian::scatter", [&](size_t index) {
+        color attenuation;
+        ray scattered;
+        diffuse.scatter(in.rays[index], in.hits[index], attenuation, scattered);
+        return scattered.direction().x();
+    });
+    measure(results, opts, counters.get(), "metal::scatter", [&](size_t index) {
+        color attenuation;
+        ray scattered;
+        shiny.scatter(ray(in.hits[index].p, in.unit_vectors[index]), in.hits[index], attenuation, scattered);
+        return scattered.direction().x();
+    });
+    measure(results, opts, counters.get(), "dielectric::scatter", [&](size_t index) {
+        color attenuation;
+        ray scattered;
+        glass.scatter(ray(in.hits[index].p, in.unit_vectors[index]), in.hits[index], attenuation, scattered);
+        return scattered.direction().x();
+    });
+    measure(results, opts, counters.get(), "random_unit_vector", [&](size_t) {
+        return random_unit_vector().x();
+    });
+    measure(results, opts, counters.get(), "refract", [&](size_t index) {
+        return refract(in.unit_vectors[index], in.normals[index], 1 / 1.5).x();
+    });
+    measure(results, opts, counters.get(), "bitmap::write_pixel_vec3 (per pixel)", [&](size_t index) {
+        const float *c = &in.colors[3 * index];
+        image.write_pixel_vec3(int(index / 128), int(index % 128), color(c[0], c[1], c[2]));
+        return 0.0;
+    });
+    // Per pixel too, but converting a whole row per call (like the camera does).
+    measure(results, opts, counters.get(), "linear_to_rgb8_row (per pixel)", [&](size_t index) {
+        if (index % 1024 != 0)
+            return 0.0;
+        linear_to_rgb8_row(&in.colors[3 * index], image_row.get() + 3 * index, 1024, 0);
+        return 0.0;
+    });
+
+    // Whole camera samples (ray paths), through the generic and the specialized
+    // kernels, for each set of materials the camera tells apart (only
+    // lambertian, only built-in, or anything). A 32x16 pass is rendered every
+    // 512 ops. It runs on this thread, so only setting up the camera adds to the time.
+    struct render_case {
+        const char *name;
+        const hittable_list &scene;
+        bool defocus;
+        bool specialize;
+    };
+    const render_case render_cases[] = {
+        {"camera sample: generic (mixed, defocus)", small_mixed, true, false},
+        {"camera sample: specialized (mixed, defocus)", small_mixed, true, true},
+        {"camera sample: generic (diffuse, pinhole)", small_diffuse, false, false},
+        {"camera sample: specialized (diffuse, pinhole)", small_diffuse, false, true},
+        {"camera sample: generic (custom, defocus)", small_custom, true, false},
+        {"camera sample: specialized (custom, defocus)", small_custom, true, true},
+    };
+    // A material from outside the library must never be taken for a built-in
+    // one, or the specialized kernels would cast it to the wrong type.
+    if (custom_diffuse(color(.5, .5, .5)).kind() != material_kind::other
+        || (small_custom.material_kinds() & material_kind_bit(material_kind::other)) == 0) {
+        std::clog << "custom_diffuse isn't treated as material_kind::other!\n";
+        return 2;
+    }
+
+    for (const render_case &rc: render_cases) {
+        camera cam;
+        setup_camera(cam, rc.defocus, rc.specialize);
+        framebuffer fb(1, 1, false);
+        std::atomic_bool cancel = false;
+        measure(results, opts, counters.get(), rc.name, [&](size_t index) {
+            if (index % 512 != 0)
+                return 0.0;
+            cam.render_pass(rc.scene, 1, fb, 0, 1, cancel);
+            return double(fb.color_data[0]);
+        });
+    }
+
+    int status = 0;
+    if (opts.json_out != nullptr)
+        write_json(opts.json_out, results);
+    if (opts.baseline != nullptr) {
+        int regressions = compare(opts.baseline, results, opts.threshold);
+        if (regressions != 0) {
+            if (regressions > 0)
+                std::cout << regressions << " kernel(s) regressed.\n";
+            status = 1;
+        }
+    }
+    return status;
+}
@@ -0,0 +1,159 @@
+// Benchmarks loading a big triangle mesh from OBJ and from the binary (mapped)
+// mesh format, along with the memory it takes and its ray hit throughput.
+#include <rt/rtweekend.h>
+#include <rt/triangle-mesh.h>
+#include <rt/material.h>
+
+#include <iostream>
+// For std::ofstream
+#include <fstream>
+// For std::chrono::steady_clock
+#include <chrono>
+// For std::filesystem::temp_directory_path()
+#include <filesystem>
+// For std::string
+#include <string>
+// For std::from_chars()
+#include <charconv>
+#include <cstring>
+
+using namespace rt;
+
+// Resident memory of this process in MiB (only implemented on Linux).
+static double resident_mib() {
+#ifdef __linux__
+    std::ifstream statm("/proc/self/statm");
+    long total_pages = 0, resident_pages = 0;
+    statm >> total_pages >> resident_pages;
+    return resident_pages * 4096.0 / (1024 * 1024);
+#else
+    return 0;
+#endif
+}
+
+static double seconds_since(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+// Writes a UV sphere with 2 * rings * segments triangles as an OBJ file.
+static void write_sphere_obj(const char *fname, int rings, int segments) {
+    std::ofstream out(fname, std::ios_base::out | std::ios_base::binary | std::ios_base::trunc);
+    // The poles are duplicated per segment, which keeps indexing simple.
+    for (int ring = 0; ring <= rings; ring++) {
+        double theta = pi * ring / rings;
+        for (int seg = 0; seg < segments; seg++) {
+            double phi = 2 * pi * seg / segments;
+            out << "v " << std::sin(theta) * std::cos(phi) << ' ' << std::cos(theta)
+                << ' ' << std::sin(theta) * std::sin(phi) << '\n';
+        }
+    }
+    for (int ring = 0; ring < rings; ring++) {
+        for (int seg = 0; seg < segments; seg++) {
+            // OBJ indices are 1-based.
+            int a = ring * segments + seg + 1;
+            int b = ring * segments + (seg + 1) % segments + 1;
+            int c = a + segments, d = b + segments;
+            out << "f " << a << ' ' << b << ' ' << d << "\nf " << a << ' ' << d << ' ' << c << '\n';
+        }
+    }
+}
+
+// Fires rays from random points towards the mesh, returns how many hit.
+static int count_hits(const hittable &mesh, int n_rays) {
+    std::srand(1);
+    int hits = 0;
+    hit_record rec;
+    for (int i = 0; i < n_rays; i++) {
+        point3 origin = 3 * random_unit_vector();
+        vec3 direction = vec3::random(-.8, .8) - origin;
+        if (mesh.hit(ray(origin, direction), interval(0.001, infinity), rec))
+            hits++;
+    }
+    return hits;
+}
+
+int main(int argl, char **args) {
+    // Default is 500 * 1000 * 2 = 1M triangles
+    int rings = 500;
+    if (argl > 1) {
+        auto result = std::from_chars(args[1], args[1] + strlen(args[1]), rings);
+        if (result.ec != std::errc() || rings < 2) {
+            std::clog << "usage: " << args[0] << " [RINGS]\n"
+                         "Benchmarks a UV sphere mesh with 4 * RINGS^2 triangles.\n";
+            return 1;
+        }
+    }
+    int segments = 2 * rings;
+    const int n_rays = 1000000;
+
+    auto tmp_dir = std::filesystem::temp_directory_path();
+    std::string obj_name = (tmp_dir / "rt-mesh-bench.obj").string();
+    std::string bin_name = (tmp_dir / "rt-mesh-bench.rtmesh").string();
+
+    std::clog << "Writing " << 2 * rings * segments << "-triangle OBJ to " << obj_name << '\n';
+    write_sphere_obj(obj_name.c_str(), rings, segments);
+
+    auto mat = make_shared<lambertian>(color(.5, .5, .5));
+
+    double base_mem = resident_mib();
+    auto start = std::chrono::steady_clock::now();
+    auto obj_mesh = mesh_data::load_obj(obj_name.c_str());
+    double obj_time = seconds_since(start);
+    double obj_mem = resident_mib() - base_mem;
+    if (obj_mesh == nullptr)
+        return 2;
+
+    std::clog << "OBJ load (parse + BVH build): " << obj_time * 1000 << " ms, "
+              << obj_mesh->triangle_count() << " triangles, " << obj_mesh->node_count()
+              << " BVH nodes, " << obj_mem << " MiB resident\n";
+
+    start = std::chrono::steady_clock::now();
+    int obj_hits = count_hits(triangle_mesh(obj_mesh, mat), n_rays);
+    double obj_trace_time = seconds_since(start);
+
+    {
+        std::ofstream out(bin_name, std::ios_base::out | std::ios_base::binary | std::ios_base::trunc);
+        if (!obj_mesh->write_binary(out))
+            return 2;
+    }
+    obj_mesh = nullptr;
+    std::filesystem::remove(obj_name);
+
+    base_mem = resident_mib();
+    start = std::chrono::steady_clock::now();
+    // It was just written above, so it doesn't need checking.
+    auto bin_mesh = mesh_data::load_binary(bin_name.c_str(), true);
+    double bin_time = seconds_since(start);
+    double bin_mem = resident_mib() - base_mem;
+    if (bin_mesh == nullptr)
+        return 2;
+
+    std::clog << "Binary load (mapped): " << bin_time * 1000 << " ms, "
+              << bin_mem << " MiB resident\n";
+
+    start = std::chrono::steady_clock::now();
+    int bin_hits = count_hits(triangle_mesh(bin_mesh, mat), n_rays);
+    double bin_trace_time = seconds_since(start);
+    std::clog << "Binary mesh after tracing: " << resident_mib() - base_mem
+              << " MiB resident (pages are only read in when touched)\n";
+
+    // What loading it without trusted = true adds (this reads in every page).
+    start = std::chrono::steady_clock::now();
+    bool valid = bin_mesh->validate();
+    std::clog << "Validating it: " << seconds_since(start) * 1000 << " ms\n";
+    if (!valid)
+        return 2;
+
+    std::clog << "Rays: " << n_rays / obj_trace_time / 1e6 << " Mrays/s (OBJ), "
+              << n_rays / bin_trace_time / 1e6 << " Mrays/s (binary), "
+              << obj_hits << " hits\n";
+
+    bin_mesh = nullptr;
+    std::filesystem::remove(bin_name);
+
+    if (obj_hits != bin_hits) {
+        std::clog << "Mismatch: " << obj_hits << " hits from OBJ mesh, "
+                  << bin_hits << " hits from binary mesh!\n";
+        return 3;
+    }
+}
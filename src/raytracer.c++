@@ -14,6 +14,12 @@
 #include <rt/bitmap.h>
 // For struct args and argument parser.
 #include <rt/args.h>
+// Denoiser post-pass
+#include <rt/denoise.h>
+// For writing the image a strip at a time
+#include <rt/strip-writer.h>
+// Interactive preview for setting up the camera
+#include <rt/preview.h>
 // OS-specific workarounds/quirks
 #include <rt/quirks.h>
 
@@ -24,6 +30,9 @@
 #include <csignal>
 // For std::filesystem::path (to handle deleting it)
 #include <filesystem>
+// For parsing preview commands
+#include <sstream>
+#include <string>
 
 using namespace rt;
 
@@ -42,6 +51,98 @@ static void sig_exit_handler(int signum) {
         std::exit(signum + 128); // The Unix signal behavior
 }
 
+static const char preview_help[] =
+"Commands (one per line, the preview restarts after each change):\n"
+"  vfov DEGREES, lookfrom X Y Z, lookat X Y Z, vup X Y Z,\n"
+"  defocus_angle DEGREES, focus_dist DIST, width PIXELS, samples NUM, depth NUM\n"
+"  show    Print the current settings (as code for main())\n"
+"  help    Print this help\n"
+"  quit    Exit right away (end of input waits for the preview to finish)\n";
+
+// Prints the camera settings the way they are written in main().
+static void print_camera(const camera &cam) {
+    auto print_point = [](const vec3 &p) {
+        std::cout << '(' << p.x() << ", " << p.y() << ", " << p.z() << ')';
+    };
+    std::cout << "cam.image_width = " << cam.image_width << ";\n"
+              << "cam.samples_per_pixel = " << cam.samples_per_pixel << ";\n"
+              << "cam.max_depth = " << cam.max_depth << ";\n"
+              << "cam.vfov = " << cam.vfov << ";\n"
+              << "cam.lookfrom = point3";
+    print_point(cam.lookfrom);
+    std::cout << ";\ncam.lookat = point3";
+    print_point(cam.lookat);
+    std::cout << ";\ncam.vup = vec3";
+    print_point(cam.vup);
+    std::cout << ";\ncam.defocus_angle = " << cam.defocus_angle << ";\n"
+              << "cam.focus_dist = " << cam.focus_dist << ";" << std::endl;
+}
+
+// Reads camera changes from stdin, and previews each of them into the output file.
+static int run_preview(camera &cam, const hittable &world, const struct args &pargs) {
+    auto write_frame = previewer::file_writer(pargs.fname, pargs.ftype);
+    previewer preview(world, pargs.n_threads, [&](const preview_frame &frame) {
+        write_frame(frame);
+        std::clog << "Preview: 1/" << frame.scale << " resolution, " << frame.samples_per_pixel
+                  << " spp, " << int(frame.seconds * 1000) << " ms"
+                  << (frame.done? " (done)\n" : "\n");
+    });
+
+    std::clog << preview_help;
+    preview.update(cam);
+
+    std::string line;
+    while (std::getline(std::cin, line)) {
+        std::istringstream command(line);
+        std::string name;
+        if (!(command >> name))
+            continue;
+
+        bool ok = true;
+        if (name == "vfov") {
+            ok = bool(command >> cam.vfov);
+        } else if (name == "lookfrom" || name == "lookat" || name == "vup") {
+            double x, y, z;
+            ok = bool(command >> x >> y >> z);
+            if (ok) {
+                point3 &p = (name == "lookfrom")? cam.lookfrom : (name == "lookat")? cam.lookat : cam.vup;
+                p = point3(x, y, z);
+            }
+        } else if (name == "defocus_angle") {
+            ok = bool(command >> cam.defocus_angle);
+        } else if (name == "focus_dist") {
+            ok = bool(command >> cam.focus_dist);
+        } else if (name == "width") {
+            ok = bool(command >> cam.image_width) && cam.image_width > 0;
+        } else if (name == "samples") {
+            ok = bool(command >> cam.samples_per_pixel) && cam.samples_per_pixel > 0;
+        } else if (name == "depth") {
+            ok = bool(command >> cam.max_depth) && cam.max_depth > 0;
+        } else if (name == "show") {
+            print_camera(cam);
+            continue;
+        } else if (name == "help") {
+            std::clog << preview_help;
+            continue;
+        } else if (name == "quit") {
+            return 0;
+        } else {
+            std::clog << "Unknown command: " << name << '\n';
+            continue;
+        }
+
+        if (!ok) {
+            std::clog << "Invalid value for " << name << '\n';
+            continue;
+        }
+        preview.update(cam);
+    }
+
+    // Input ended (like when it is piped in), so finish what was asked for.
+    preview.wait_until_done();
+    return 0;
+}
+
 int main(int argl, char **args) {
     // Setup quirks to help ensure the environment
     int locale_is_good = ensure_locale();
@@ -58,6 +159,28 @@ int main(int argl, char **args) {
 
     struct args pargs = parse_args(argl, args);
 
+    if (pargs.preview) {
+        if (pargs.fname == nullptr) {
+            std::clog << "Previews need an output file (which is rewritten for every frame).\n";
+            return 1;
+        }
+        if (pargs.denoise || pargs.strip_lines > 0) {
+            std::clog << "Previews can't be used with --denoise or --strip-lines.\n";
+            return 1;
+        }
+    }
+
+    if (pargs.strip_lines > 0) {
+        if (pargs.denoise) {
+            std::clog << "Denoising needs the whole image, so it can't be used with strips.\n";
+            return 1;
+        }
+        if (!strip_writer::type_is_supported(pargs.ftype)) {
+            std::clog << "This file type can't be written a strip at a time.\n";
+            return 1;
+        }
+    }
+
     // If not UTF-8, it returns the codepage in locale_is_good
     if (locale_is_good > 0) {
         // Terminal escapes supported, so do fancy print
@@ -146,6 +269,8 @@ int main(int argl, char **args) {
     // Note: This is a really high quality setting that makes it take forever.
     // It was at 100 previously, perhaps 50 would be good for testing?
     cam.samples_per_pixel = 500;
+    if (pargs.samples > 0)
+        cam.samples_per_pixel = pargs.samples;
     cam.max_depth = 50;
 
     // PoV settings
@@ -160,11 +285,46 @@ int main(int argl, char **args) {
 
     // Note: +x is right, +y is up, +z is outwards relative to camera.
 
-    // Initializes camera, renders, writes a PPM to stdout. (Make it more flexible in the future.)
-    auto raw_bmp = cam.render(world, pargs.n_threads);
+    if (pargs.preview) {
+        // The preview is meant to be kept, so don't delete it on Ctrl-C.
+        std::signal(SIGINT, SIG_DFL);
+        std::signal(SIGTERM, SIG_DFL);
+        out_file.close();
+        return run_preview(cam, world, pargs);
+    }
 
     // This is a trick to avoid writing the code twice for stdout and a file.
     std::ostream &outstream = (pargs.fname != nullptr)? out_file : std::cout;
 
+    if (pargs.strip_lines > 0) {
+        // Strips go straight to the encoder (or the mapped file for BMP), so
+        // the full image never has to fit in memory.
+        std::unique_ptr<strip_writer> writer;
+        if (pargs.ftype == BitmapOutput::BMP && pargs.fname != nullptr) {
+            // The mapped file reopens it, and Windows won't allow that while it's open.
+            out_file.close();
+            writer = strip_writer::create_mapped_bmp(pargs.fname);
+        } else {
+            writer = strip_writer::create(outstream, pargs.ftype);
+        }
+
+        if (!cam.render_strips(world, pargs.n_threads, pargs.strip_lines, *writer)) {
+            std::clog << "Failed to write the image.\n";
+            return 5;
+        }
+        return 0;
+    }
+
+    // Initializes camera, renders, writes a PPM to stdout. (Make it more flexible in the future.)
+    // With denoising, the image stays in floating-point form (along with the
+    // albedo and normal buffers which guide the denoiser) until it is done.
+    auto raw_bmp = [&]() {
+        if (!pargs.denoise)
+            return cam.render(world, pargs.n_threads);
+        auto fb = cam.render_linear(world, pargs.n_threads, true);
+        denoise(fb, pargs.n_threads);
+        return fb.to_bitmap();
+    }();
+
     raw_bmp.write_to_file(outstream, pargs.ftype);
 }